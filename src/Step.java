@@ -38,6 +38,12 @@ public class Step {
   private int num_dynamites_held = 0;
   private int num_stones_held = 0;
 
+  // Delta views (-d), see write_view()
+  final static int KEYFRAME_EVERY = 64;
+  private boolean delta = false;
+  private char[] last_sent = new char[25];
+  private int since_key = KEYFRAME_EVERY;
+
   private static void swanSong( String message ) {
     System.out.println( message );
     System.exit(-1);
@@ -262,16 +268,182 @@ public class Step {
     }
   }
 
+  private void write_view( OutputStream out ) throws IOException {
+    int i,j;
+    get_view();
+    if( delta ) {
+      write_delta( out );
+      return;
+    }
+    for( i=0; i < 5; i++ ) {
+      for( j=0; j < 5; j++ ) {
+        if( !(( i == 2 )&&( j == 2 ))) {
+          out.write( view[i][j] );
+        }
+      }
+    }
+  }
+
+  // What the agent would expect from the last view it got, if it did not
+  // move ('='), moved forward ('F', row 0 is new), turned left or right
+  private char[] predict( char op ) {
+    char[] p = new char[25];
+    int a,b;
+    for( a=0; a < 5; a++ ) {
+      for( b=0; b < 5; b++ ) {
+        switch( op ) {
+         case '=': p[a*5+b] = last_sent[a*5+b]; break;
+         case 'F': p[a*5+b] = ( a == 0 ) ? 0 : last_sent[(a-1)*5+b]; break;
+         case 'L': p[a*5+b] = last_sent[(4-b)*5+a]; break;
+         case 'R': p[a*5+b] = last_sent[b*5+4-a]; break;
+        }
+      }
+    }
+    return( p );
+  }
+
+  // Send only how to get this view from the last one and the cells
+  // that are not as predicted, and the whole view every KEYFRAME_EVERY
+  private void write_delta( OutputStream out ) throws IOException {
+    char[] now = new char[25];
+    char[] ops = { '=', 'F', 'L', 'R' };
+    char best = '=';
+    int best_cost = 100;
+    int a,b,k;
+
+    for( a=0; a < 5; a++ ) {
+      for( b=0; b < 5; b++ ) {
+        now[a*5+b] = ( a == 2 && b == 2 ) ? 0 : view[a][b];
+      }
+    }
+
+    if( ++since_key >= KEYFRAME_EVERY ) {
+      since_key = 0;
+      out.write( 'K' );
+      for( k=0; k < 25; k++ ) {
+        if( k != 12 ) out.write( now[k] );
+      }
+      last_sent = now;
+      return;
+    }
+
+    for( char op : ops ) {
+      char[] p = predict( op );
+      int cost = ( op == 'F' ) ? 5 : 0;
+      for( k=( op == 'F' ) ? 5 : 0; k < 25; k++ ) {
+        if( k != 12 && p[k] != now[k] ) cost += 2;
+      }
+      if( cost < best_cost ) {
+        best = op;
+        best_cost = cost;
+      }
+    }
+
+    char[] p = predict( best );
+    out.write( best );
+    if( best == 'F' ) {
+      for( k=0; k < 5; k++ ) out.write( now[k] );
+    }
+    int count = 0;
+    for( k=( best == 'F' ) ? 5 : 0; k < 25; k++ ) {
+      if( k != 12 && p[k] != now[k] ) count++;
+    }
+    out.write( count );
+    for( k=( best == 'F' ) ? 5 : 0; k < 25; k++ ) {
+      if( k != 12 && p[k] != now[k] ) {
+        out.write( k );
+        out.write( now[k] );
+      }
+    }
+    last_sent = now;
+  }
+
+  // An agent asks for delta views with a 0 byte before its first action,
+  // which is no action and no batch count. It is answered 'D' if the engine
+  // was started with -d, and the views after the first are deltas, or 'N'.
+  // An agent which does not ask is never sent anything else, so nobody waits
+  // for a reply that is not coming. Return the byte after the question,
+  // first if there was none
+  private int answer_delta( int first, InputStream in, OutputStream out,
+                            boolean offer ) throws IOException {
+    if( first != 0 ) {
+      return( first );
+    }
+    delta = offer;
+    out.write( offer ? 'D' : 'N' );
+    out.flush();
+    return( in.read() );
+  }
+
+  // Batch protocol (-b): the agent sends a count byte and that many actions,
+  // they are applied until one fails or the game ends, and a count byte and
+  // the view after each action applied are sent back in one write.
+  private void play_batch( InputStream in, OutputStream out, int maxmoves,
+                           boolean silent, boolean offer ) throws IOException {
+    DataInputStream data = new DataInputStream( in );
+    ByteArrayOutputStream views = new ByteArrayOutputStream();
+    byte[] actions = new byte[255];
+    int m = 0;
+    int n,k;
+
+    write_view( out );
+    out.flush();
+
+    while( true ) {
+      n = data.read();
+      if( m == 0 ) {
+        n = answer_delta( n, data, out, offer );
+      }
+      if( n < 0 ) {
+        throw new IOException();
+      }
+      data.readFully( actions, 0, n );
+
+      views.reset();
+      views.write( 0 );
+      for( k=0; k < n; k++ ) {
+        if( ++m > maxmoves ) {
+          swanSong("Exceeded maximum of "+ maxmoves +" moves.\n");
+        }
+        char action = (char) actions[k];
+        if( !silent ) {
+          System.out.println("action = "+ action );
+        }
+        boolean done = apply( action );
+        if( !silent ) {
+          print_map();
+        }
+        if( game_won ) {
+          swanSong( "Game Won in "+ m +" moves." );
+        }
+        else if( game_lost ) {
+          swanSong( "Game Lost." );
+        }
+        write_view( views );
+        if( !done ) {
+          k++;
+          break;
+        }
+      }
+      byte[] reply = views.toByteArray();
+      reply[0] = (byte) k;
+      out.write( reply );
+      out.flush();
+    }
+  }
+
   private static void printUsage()
   {
     swanSong(
-    "Usage: java Step [-p <port>] -i map [-m <maxmoves>] [-s]\n");
+    "Usage: java Step [-p <port>] [-b] [-d] -i map [-m <maxmoves>] [-s]\n");
   }
 
   public static void main( String[] args )
   {
     Step step;
     boolean silent = false;
+    boolean batch  = false;
+    boolean delta  = false;
     String mapName = "";
     char action  = 'F';
     int maxmoves = 10000;
@@ -311,6 +483,14 @@ public class Step {
         silent = true;
         k++;
       }
+      else if( args[k].compareTo("-b") == 0 ) {
+        batch = true;
+        k++;
+      }
+      else if( args[k].compareTo("-d") == 0 ) {
+        delta = true;
+        k++;
+      }
       else {
         printUsage();
       }
@@ -330,7 +510,6 @@ public class Step {
       OutputStream out          = null;
       ServerSocket serverSocket = null;
       Socket clientSocket       = null;
-      int i,j;
 
       try {
         serverSocket = new ServerSocket( port );
@@ -344,17 +523,14 @@ public class Step {
       }
 
       try {
+        if( batch ) {
+          step.play_batch( in, out, maxmoves, silent, delta );
+        }
         for( m=1; m <= maxmoves; m++ ) {
-          step.get_view();
-          for( i=0; i < 5; i++ ) {
-            for( j=0; j < 5; j++ ) {
-              if( !(( i == 2 )&&( j == 2 ))) {
-                out.write( step.view[i][j] );
-              }
-            }
-          }
+          step.write_view( out );
           out.flush();
-          action = (char) in.read();
+          action = (char) ( m == 1 ? step.answer_delta( in.read(), in, out, delta )
+                                   : in.read() );
           if( !silent ) {
             System.out.println("action = "+ action );
           }
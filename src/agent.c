@@ -8,36 +8,89 @@
 ***********************************************************************************************************************
 Data structure used: 
 struct Status: record the current position and direction of the agent, and whether it has key, axe, treasure, raft, and
-               number of stones. Also 'a' is the top-left point of the map it has seen and 'b' is the bottom-right 
+               number of stones and dynamite. Also 'a' is the top-left point of the map it has seen and 'b' is the bottom-right 
                point of the map it has seen. Also record whether has been to sea.
 
 struct astarNode: this node record the position and direction of the state that agent would be. Also the g: cost, h:
-                  heuristic value, f: the sum of g and h. 'steps' record the steps agent needs to get to this state 
-                  from current state. And a pointer point to next node.
+                  heuristic value, f: the sum of g and h. 'parent' is the index of the node it came from and 'act' the
+                  action taken from there, so the steps are only built once when the goal is reached. Nodes live in
+                  astar_arena, which is allocated once and reused by every search. And seq is the order it was
+                  pushed, used to break ties between same f.
+    astarNodeHead: the open list, a binary min-heap ordered by f then seq. astar_index[] of the cell records the heap
+                   slot of the open node in each direction, so finding the node in same state is O(1).
     astarnode_insert(): check if there is already node in same state and with lower f values, which means more efficient
-                        and don't insert. Or delete the original one, and insert new one in the right position based on
-                        the f value.
+                        and don't insert. Or replace the original one and sift it to the right position based on the
+                        f value. Both push and pop are O(log n).
+    The heap took the place of a sorted linked list, which was walked on every insert. It pops states in the same
+    (f, seq) order, so it expands the same states. What the heap costs can be measured again with sim_stats -a 1000 on
+    s0-s9: forward A* with heuristic_turns over routes between points of the known map, fewest cycles of 3 runs:
+        world  routes  states expanded  kcycles  cycles per state
+        s0     266     15044            6550     435
+        s1     487     10076            4961     492
+        s2     506     66218            29273    442
+        s3     354     7811             3535     452
+        s4     306     17512            7354     419
+        s5     356     14490            7751     534
+        s6     404     22264            10374    465
+        s7     392     35873            16990    473
+        s8     523     48736            20584    422
+        s9     368     10186            4802     471
+
+struct cell, chunk: all the agent knows of a point (map, seen, been, region, frontier slot) and what the planners keep
+                   there. The map is kept in CHUNK_SIZE x CHUNK_SIZE chunks, only allocated when updata_map gets near
+                   them (the view and one point around), so the start is (0,0), the map can grow any way and be
+                   as big as it is, and every scan over the whole map only goes over the chunks allocated. chunk_dir
+                   finds the chunk of a point in a window of chunk positions which grows when the agent walks out of
+                   it. cell_peek() reads a point (the unknown cell if nothing allocated there), cell_at() a point to
+                   write. A cell id (chunk*CHUNK_CELLS+place in the chunk) names a point in the queues and the
+                   union-find. The chunks are kept for the next game played by the same agent.
+
+struct plan: the actions decided by find_a_path, the buffer grows when a longer plan is needed.
 
 struct tool, door, tree is just used to record the tools, doors and trees that have been seen but not reach/open/chop yet.
 
 We have linked lists to store all tools, doors, trees that have been seen.
 
+struct agent: everything the agent knows and works with in one game (map, status, lists, plan, regions, frontier, cost
+              field, A* buffers), so nothing is global but dir_dx/dir_dy. Every function takes the Agent it works for,
+              agent_create() gives one and agent_free() frees it. Games played with different agents share nothing,
+              so they can run on different threads of one process.
+
 Algorithm:
-main: 1. Get the current view, as current direction has four situations, so rotate the view to the right direciton, which
-        is up-north, right-east, down-south, left-south. And use the view to update the global map. The global map will be
-        used to make decision later.
-      2. Using the global map to make a dicision what is going to do in the next several actions, cause it may needs a 
+agent_init()/agent_act(): the agent without the socket, agent_act() takes one view and gives the next action (0 when it
+                          has nothing to do). main reads the views from the server and sends back what agent_act() says,
+                          and sim.c calls them straight from the C engine. Build with -DAGENT_NO_MAIN to leave main out.
+                          server.c plays many games at once over sockets with one Agent for each.
+
+main: 1. Get the current view, as current direction has four situations, view_index[direction] tells which view cell is
+        each point around the agent (up-north, right-east, down-south, left-west), so updata_map writes the view
+        straight to the agent's map in one pass, and skips points which look the same as last time. The map
+        will be used to make decision later.
+      2. Using the map to make a dicision what is going to do in the next several actions, cause it may needs a 
          few actions to get to one desired point. And if we only make one action decision at each time, the agent may 
          get stuck at some point.
       3. The dicision usually has more than one actions, so in the next few iteration, just pass the action one by one to
          the server, until the decision finished.
-
-find_a_path: 1. If we are in go to lake state, just go to the destination we have made last time.
-             2. If we already got treasure, try to go back to original point if possible.
+      With -b (batch mode, the engine must be started with -b too) main sends the rest of the plan in one write
+      and gets back a view for each action the engine took, agent_observe_batch() takes them in order.
+      With -d the agent asks for delta views, an engine started with -d (java Step -d) sends them after the first
+      view. pipe.c rebuilds each view from the last one and the few cells sent, updata_map then only touches the
+      points that changed.
+
+stats: built with -DAGENT_STATS (make sim_stats), every find_a_path branch taken and the work done by regions, flood
+       fill, the cost field, A* search and the stone field, with their cycles, are counted. agent_stats_dump() writes
+       them as one JSON line at the end of the game. Without it the STAT_ macros are empty. agent_astar_compare()
+       (sim_stats -a) runs both A* modes with every heuristic on the same routes over the map known and writes
+       the states they expanded.
+
+find_a_path: 1. If we are in go to lake state, cross to the destination we have made last time by stones.
+                If the treasure has been seen, plan_search() the whole way to it and back on the known map.
+             2. If we already got treasure, try to go back to original point if possible, with A*.
              3. If we seen some tools before and not collect it yet, if accessable, go to collect it.
              4. If a door is in the neighbor point of the current point, turn to it and open it.
              5. If we have key and saw a door before, go to the neighbor point of the door if possible.
              6. Try to explore the map, basically go to the point we have seen but not been there, also accessable.
+                The candidates are kept in frontier[] by updata_map, so only they are checked, not the whole map.
              6. If a tree is in the neighbor point of the current point, turn to it and chop it.
              7. If we have axe and saw a tree before, to to the neighbor point of the tree if possible.
              If the code reach here, means agent stuck on the land or the sea.
@@ -46,26 +99,97 @@ find_a_path: 1. If we are in go to lake state, just go to the destination we hav
                 b: If we have treasure, go to the land of start point.
                 c: Go to the land which has door.
              9. If we are hang around on the land:
-                a: If we have stones, try to go to a lake and we can get stone on the other land.
+                a: If we have stones, go to the stone which takes fewest of them to get to.
                 b: Try to use raft as stone to pass the lake.
                 c: Go back to sea.
              10. If still not get treasure yet, treasure is on an island, go to the island using stones.
-
-is_accessable: Mark the neighbor point if it is reachable, doing this recursively, so the accessable[][] will spread out
-               this is basiclly like BFS to mark all accessable points.
-
-get_path_a_star: Using A* search to find the path from src to dest. The prev-request is these two points should be accessable,
-                 so usually I call is_accessable() first.
+             Both stone branches pick their target from the stone field, walk to the shore it is crossed from,
+             and go on lake state for the crossing.
+             11. If nothing else to do, collect the dynamite left, then plan_search() to the cheapest point of the
+                 frontier with the tools on the way (blasting if it has to).
+
+is_accessable: Mark all points reachable from src as accessable. flood_fill()
+               does a BFS, which points can be passed is decided by a Passable function for the land or the sea, and
+               with transfer the sea next to the land (or land next to the sea) is marked too. A point is marked
+               with the number of the fill, so nothing is cleared between fills.
+
+regions: Every known land point and sea point is in a union-find region with the neighbors of the same kind, updata_map
+         calls region_update() for each point it writes, so when a door is opened, a tree chopped or a stone put, the
+         new point just joins its neighbors. reachable() compares the region of a point with the one of the agent.
+         Only when a point leaves its region (the sea turned to a stone) everything is built again on next query.
+         region_graph_build() finds in one pass which land and sea regions are next to each other, and the first land
+         point between them, so find_landing()/find_crossing() answer "where to land to get to that island" or "which
+         sea takes me to that island" without flooding.
+
+field_build: BFS over (x,y,direction) from the agent once per decision, as every action costs 1 this gives the real
+             cost (turns included) to every state. The tools, doors, explore and trees branches pick the cheapest
+             target from it and field_path() just walks back the last actions, no search per target.
+
+stone_build: 0-1 BFS over the points from the agent, walking on land costs nothing and every sea point stepped on
+             costs one stone, so it gives the fewest stones needed to get to every point in one pass. A stone or
+             the treasure is a target if it takes at least one and no more than we have, stone_path() walks the
+             parents back into the crossing.
+
+plan_search: A* over labels (point, direction, key, axe, raft, on raft, stones, dynamite, treasure, and which stones,
+             dynamite and trees of the known map are used up), every action costs 1 and the moves follow the engine:
+             a door takes 'u' with the key, a tree 'c' with the axe and gives a raft, the sea is sailed on a raft or
+             stepped on with a stone, landing loses the raft. A wall, or a door or tree which can not be opened or
+             chopped, takes 'b' with a dynamite, priced PLAN_BLAST_PRICE/dynamite held more than its two actions,
+             so the last dynamite is only used to save many moves. Doors and walls opened get a bit of used too
+             (while there are bits left), so a plan going back through them does not open them again. A label is dropped when another at the same point and
+             direction is as cheap with at least as much held and nothing more used up (dominance), so the inventory
+             does not multiply the states. The treasure and back to the start is found with the Manhattan distance
+             through the treasure as heuristic, the frontier with none. A search which finds nothing is not done
+             again until the inventory changes or the map changes next to the points it got to.
+
+get_path_a_star: Using A* search to find the path from src to dest. Which points can be passed is given by a Passable
+                 function (usually agent_passable(), the land or sea agent is on), the dest can always be entered.
+                 Each call picks ASTAR_FORWARD or ASTAR_BIDIRECTIONAL: the second also searches back from every
+                 direction at dest, and the two sides are joined at a point with the turns between the directions
+                 they got there in, so the join is exact. The agent searches forward: with heuristic_turns the
+                 bidirectional search expands about as many states and each costs more. States expanded and
+                 kcycles over the same routes (sim_stats -a 1000, turns, fewest kcycles of 3 runs):
+                     world  routes  forward  bidirectional  forward kcycles  bidirectional kcycles
+                     s0     266     15044    14981          6550             6920
+                     s1     487     10076    10396          4961             5675
+                     s2     506     66218    65669          29273            30235
+                     s3     354     7811     7711           3535             3744
+                     s4     306     17512    17776          7354             8011
+                     s5     356     14490    13579          7751             7749
+                     s6     404     22264    22209          10374            10920
+                     s7     392     35873    33341          16990            16657
+                     s8     523     48736    47026          20584            20906
+                     s9     368     10186    10450          4802             5262
+                 The Heuristic is given too: heuristic_manhattan, heuristic_turns (adds the turns the agent must
+                 make at least, facing the way it does) or heuristic_alt (ALT: the most of that and the bound from the
+                 BFS moves to a few landmarks). All give the same number of actions. The agent searches with
+                 astar_heuristic, heuristic_turns unless agent_use_alt() (sim -A) picks ALT. updata_map only marks
+                 the landmarks dirty, alt_prepare() builds them again (5 BFS of the known map) on the next ALT
+                 search, so an agent without ALT never pays for them.
+
+dstar: A plan of moves from field_path() or get_path_a_star() is not followed blindly. dstar_track() keeps its goal,
+       and after each view agent_observe() checks the rest of the plan against the points changed with a D* Lite
+       search over (x,y,direction) from the goal. The search is made on the first view which changes the map, then
+       it keeps g/rhs in the cells and only the moves into a changed point are updated, so a check costs about as much
+       as the change. A plan which got blocked, or is longer than the best path now, is replaced by the path down the
+       costs from the agent, and a goal which can not be got to any more drops the plan so find_a_path decides again.
+       In batch mode the engine already took the actions sent, so the check is only done after the last view.
 
 ***********************************************************************************************************************
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <time.h>
+#if defined(AGENT_STATS) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
 
 #include "pipe.h"
+#include "agent.h"
 
 
 
@@ -76,13 +200,17 @@ typedef int bool;
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
-#define MAX_SIZE 80
+// The map is kept in square chunks of CHUNK_SIZE points, allocated when first seen
+#define CHUNK_SHIFT 4
+#define CHUNK_SIZE (1<<CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE-1)
+#define CHUNK_CELLS (CHUNK_SIZE*CHUNK_SIZE)
+#define CHUNK_ID_SHIFT (2*CHUNK_SHIFT)
+// Chunks across the window of chunks of a new agent, 128 points
+#define CHUNK_DIR_START 8
 
-// This include 2 layer of '.' at border
-#define MAP_SIZE 2*MAX_SIZE-1+2*2
-
-// At the middle of the map
-#define START_POINT MAX_SIZE-1+2
+// Where the agent starts, the map grows from here in any direction
+#define START_POINT 0
 
 // Char for different stuffs
 // Tools
@@ -97,6 +225,82 @@ typedef int bool;
 #define SOUTH 2
 #define WEST 3
 
+// Kinds of regions
+#define REGION_NONE 0
+#define REGION_LAND 1
+#define REGION_SEA 2
+
+// Cost of a state D* Lite has not got a path from yet, small enough to add a key to
+#define DSTAR_INF (1<<29)
+
+// How get_path_a_star() searches: one search from src, or one from each end meeting in the middle
+#define ASTAR_FORWARD 0
+#define ASTAR_BIDIRECTIONAL 1
+// Sides of a search, the one from src is the only one of a forward search
+#define ASTAR_FROM_SRC 0
+#define ASTAR_FROM_DEST 1
+// Landmarks of the ALT heuristic
+#define ALT_LANDMARKS 4
+
+// Branches of find_a_path, in the order they are tried
+#define BRANCH_GO_ON_LAKE 0
+#define BRANCH_PLAN_WIN 1
+#define BRANCH_GO_HOME 2
+#define BRANCH_TOOL 3
+#define BRANCH_OPEN_DOOR 4
+#define BRANCH_GO_DOOR 5
+#define BRANCH_EXPLORE 6
+#define BRANCH_CHOP_TREE 7
+#define BRANCH_GO_TREE 8
+#define BRANCH_LAND_FOR_TREE 9
+#define BRANCH_LAND_FOR_HOME 10
+#define BRANCH_LAND_FOR_DOOR 11
+#define BRANCH_STONE_LAKE 12
+#define BRANCH_RAFT_LAKE 13
+#define BRANCH_SEA_CROSSING 14
+#define BRANCH_GO_SEA 15
+#define BRANCH_STONE_TREASURE 16
+#define BRANCH_STONE_ANY_LAKE 17
+#define BRANCH_DYNAMITE 18
+#define BRANCH_PLAN_EXPLORE 19
+#define BRANCH_NONE 20
+#define BRANCH_NUM 21
+
+// What plan_search() looks for
+#define PLAN_WIN 0
+#define PLAN_EXPLORE 1
+#define PLAN_GOALS 2
+
+// What a planner label holds, PLAN_SAIL if it is on the sea on the raft
+#define PLAN_KEY 1
+#define PLAN_AXE 2
+#define PLAN_RAFT 4
+#define PLAN_SAIL 8
+#define PLAN_TREASURE 16
+
+// Stones, dynamite and trees, then the doors and walls opened, the planner tells apart (one bit each of used),
+// the others are taken as giving nothing and opened again
+#define PLAN_MAX_ITEMS 32
+// Moves a blast costs more than its actions with one dynamite held, less the more held
+#define PLAN_BLAST_PRICE 16
+// Most labels of one search, a map with many items gives up instead of taking long
+#define PLAN_MAX_LABELS (1<<18)
+// Open lists of plan_search(), one more than f can grow by in one action
+#define PLAN_BUCKETS (PLAN_BLAST_PRICE+4)
+
+// Planner counters and timers, only built with -DAGENT_STATS, otherwise they cost nothing
+#ifdef AGENT_STATS
+#define STAT_ADD(name, n) (agent->stats.name += (n))
+#define STAT_BRANCH(b) (agent->stats.branch[b]++)
+#define STAT_TIMER_START(t) unsigned long long t = stats_clock()
+#define STAT_TIMER_STOP(name, t) (agent->stats.name += stats_clock()-(t))
+#else
+#define STAT_ADD(name, n) ((void)0)
+#define STAT_BRANCH(b) ((void)0)
+#define STAT_TIMER_START(t) ((void)0)
+#define STAT_TIMER_STOP(name, t) ((void)0)
+#endif
+
 //*********************************************************************************************************************
 
 struct point
@@ -105,7 +309,7 @@ struct point
     int y;
 };
 
-// Status for agent, global
+// Status for agent
 struct Status
 {
     struct point pos;
@@ -115,6 +319,7 @@ struct Status
     bool treasure;
     bool raft;
     int num_stone;
+    int num_dynamite;
     struct point a;// top-left point have known
     struct point b;// bottom-right point have known
     bool been_to_sea;
@@ -128,116 +333,119 @@ struct astarNode
     int g;
     int h;
     int f;
-    char steps[200];
-    struct astarNode* next;
+    int seq;
+    int parent;
+    char act;
 };
 
 typedef struct astarNode* AstarNode;
 
+// Open list of one side of A*, binary min-heap of arena indexes ordered by f, ties broken by insertion order
 struct astarNodeHead
 {
+    int side;
     int num;
-    AstarNode list;
+    int seq;
+    int* heap;
 };
 
 typedef struct astarNodeHead* AstarNodeHead;
 
-AstarNode astarNode_create(int x, int y, int direction, int g, int h, char act, char* steps)
+// A state of plan_search(): where, facing, what is held (PLAN_ bits and counts) and which of plan_items are used up.
+// The action(s) from parent got here with g of them, f is g and the heuristic. dead if a better label came later,
+// next is the next label of the same point and direction, open_next the next of the same f in the open list
+struct planLabel
 {
-    AstarNode ret = malloc(sizeof(struct astarNode));
-    ret->x=x;
-    ret->y=y;
-    ret->direction=direction;
-    ret->g=g;
-    ret->h=h;
-    ret->f=g+h;
-    ret->next=NULL;
-    int i;
-    for(i=0; i<g; ++i)
-    {
-        if(i==g-1) ret->steps[i] = act;
-        else ret->steps[i] = steps[i];
-    }
-    return ret;
-}
+    int cell;
+    int dir;
+    int have;
+    int stones;
+    int dynamite;
+    unsigned int used;
+    int g;
+    int f;
+    int parent;
+    char act[2];
+    bool dead;
+    int next;
+    int open_next;
+};
 
-void astarNode_insert(AstarNodeHead queue, AstarNode node)
+typedef struct planLabel* PlanLabel;
+
+// Growable buffer of actions planned
+struct plan
 {
-    if(queue->num==0)
-    {
-        queue->list=node;
-        queue->num++;
-        return;
-    }
-    AstarNode curr = queue->list;
-    AstarNode prev = queue->list;
-    assert(curr!=NULL);
+    char* steps;
+    int cap;
+};
 
-    while(curr != NULL)
-    {
-        // Find a node in same state
-        if(curr->x==node->x && curr->y==node->y && curr->direction==node->direction)
-        {
-            // Existing one is more efficient, don't insert
-            if(curr->f < node->f) 
-            {
-                free(node);
-                return; 
-            }
-            // Delete existing one
-            if(curr==queue->list)
-            {
-                queue->list = curr->next;
-                queue->num--;
-                free(curr);
-            }
-            else
-            {
-                prev->next = curr->next;
-                queue->num--;
-                free(curr);
-            }
-            break;
-        }
-        prev = curr;
-        curr = curr->next;
-    }
+typedef struct plan* Plan;
 
-    curr = queue->list;
-    prev = queue->list;
+// What the planner did in a game, see STAT_ADD
+struct stats
+{
+    long decisions;
+    long branch[BRANCH_NUM];
+    long reachable_calls;
+    long region_rebuilds;
+    long flood_fills;
+    long flood_cells;
+    long field_builds;
+    long field_states;
+    long astar_searches;
+    long astar_pushed;
+    long astar_popped;
+    long astar_reinserted;
+    long astar_bidir_searches;
+    long astar_bidir_expanded;
+    long alt_builds;
+    long alt_cells;
+    long stone_builds;
+    long stone_cells;
+    long plan_searches;
+    long plan_labels;
+    long plan_expanded;
+    long dstar_checks;
+    long dstar_expanded;
+    long plans_repaired;
+    long plans_dropped;
+    unsigned long long find_a_path_cycles;
+    unsigned long long astar_cycles;
+    unsigned long long flood_cycles;
+    unsigned long long field_cycles;
+    unsigned long long stone_cycles;
+    unsigned long long plan_cycles;
+    unsigned long long dstar_cycles;
+};
 
-    if(queue->list==NULL)
-    {
-        queue->list = node;
-        queue->num++;
-        return;
-    }
+// A land region next to a sea region, (x,y) is the first land point between them in row order and
+// (seaX,seaY) the sea next to it
+struct regionEdge
+{
+    int land;
+    int sea;
+    int x;
+    int y;
+    int seaX;
+    int seaY;
+    int next;
+};
 
-    while(curr!=NULL)
-    {
-        if(curr->f > node->f)
-        {
-            if(prev==curr)
-            {
-                queue->list = node;
-                node->next = curr;
-            }
-            else
-            {
-                prev->next = node;
-                node->next = curr;
-            }
-            queue->num++;
-            return;
-        }
-        prev=curr;
-        curr=curr->next;
-    }
-    queue->num++;
-    prev->next = node;
+// Whether a point can be passed, used by flood_fill
+typedef bool (*Passable)(Agent agent, int x, int y);
 
-    return;
-}
+// Lower bound of the actions between a state of A* and a point: from the state to the point on the side from src,
+// from the point (facing any way) to the state on the side from dest. Consistent, so A* never opens a state again
+typedef int (*Heuristic)(Agent agent, int side, int x, int y, int dir, int targetX, int targetY);
+
+// A state in the open list of D* Lite (cell id*4+direction) with its key, ordered by k1 then k2
+struct dstarKey
+{
+    int k1;
+    int k2;
+    int state;
+};
 
 struct tool
 {
@@ -267,453 +475,1102 @@ struct tree
 
 typedef struct tree* Tree;
 
+// All the agent knows of one point of the map, and what the planners keep there
+struct cell
+{
+    char map;
+    char region_kind;
+    bool seen;
+    bool been;
+    // Number of the flood fill which reached it, so there is nothing to clear before the next
+    int accessable;
+    // Union-find of connected land or sea, parent as cell id, kept up to date by updata_map
+    int region_parent;
+    int region_size;
+    // First edge of the land region this cell is the root of
+    int region_edge_head;
+    // Index in frontier+1, 0 if not in it
+    int frontier_slot;
+    // Cost from the agent to each direction of this point in this decision, and the last action to get there.
+    // Only valid where field_stamp is field_id
+    int field_dist[4];
+    char field_act[4];
+    int field_stamp[4];
+    // For each side of A*: heap slot+1 of the open node in each direction, 0 if not open, the number of the search
+    // that last analysed each direction and the node it was analysed with
+    int astar_index[2][4];
+    int astar_analysed[2][4];
+    int astar_node[2][4];
+    // Moves from each ALT landmark, only valid where alt_stamp is alt_id. alt_visit is the last BFS that got here
+    int alt_dist[ALT_LANDMARKS];
+    int alt_stamp;
+    int alt_visit;
+    // D* Lite of the plan being followed: cost from each direction to its goal and the one step lookahead of it,
+    // only valid where dstar_stamp is dstar_id, and open list slot+1, 0 if not open
+    int dstar_g[4];
+    int dstar_rhs[4];
+    int dstar_stamp[4];
+    int dstar_index[4];
+    // Fewest stones to get here from the agent in this decision and the cell id got here from, -1 at the agent.
+    // Only valid where stone_stamp is stone_id
+    int stone_cost;
+    int stone_from;
+    int stone_stamp;
+    // First label of plan_search() in each direction, only valid where plan_stamp is plan_id
+    int plan_head[4];
+    int plan_stamp[4];
+    // Number of the last plan_search() for PLAN_WIN which failed and got here
+    int plan_reached;
+};
+
+// CHUNK_SIZE x CHUNK_SIZE points from (x,y), cell id of a point is chunk id*CHUNK_CELLS+(y&CHUNK_MASK)*CHUNK_SIZE+(x&CHUNK_MASK)
+struct chunk
+{
+    int x;
+    int y;
+    struct cell cells[CHUNK_CELLS];
+};
+
+typedef struct chunk* Chunk;
+
+// Everything one agent knows about its game, so many games can be played at once, one Agent each
+struct agent
+{
+    // Chunks seen this game by id, chunks_alloc of them are allocated and kept for the next game.
+    // chunk_dir is the id of the chunk at each chunk position of a dir_w x dir_h window from chunk (dir_x,dir_y),
+    // -1 where nothing was seen
+    Chunk* chunks;
+    int chunks_num;
+    int chunks_alloc;
+    int chunks_cap;
+    int* chunk_dir;
+    int dir_x;
+    int dir_y;
+    int dir_w;
+    int dir_h;
+    // Points the per cell arrays below can hold
+    int cells_cap;
+
+    struct Status status;
+
+    Tool tool_list;
+    Door door_list;
+    Tree tree_list;
+    struct point* Treasure;
+
+    // The decision being carried out, one step per agent_act()
+    struct plan agent_plan;
+    int num_of_steps;
+    int curr_step;
+    // Wall time spent in find_a_path this game
+    long long plan_ns;
+
+#ifdef AGENT_STATS
+    struct stats stats;
+#endif
+
+    bool go_on_lake;
+    int stoneX;
+    int stoneY;
+
+    // The 5x5 points around the agent row by row, offset from the agent and the view cell for each direction
+    int view_dx[25];
+    int view_dy[25];
+    int view_index[4][25];
+
+    // Points of the map changed by the last view, for planners which only look at what changed
+    struct point changed[24];
+    int changed_num;
+
+    // Queue used by flood_fill, each point as cell id, and the number of the last fill
+    int* flood_queue;
+    int flood_id;
+
+    bool region_dirty;
+
+    // Pairs of land and sea regions next to each other, listed by land region root
+    struct regionEdge* region_edges;
+    int region_edges_num;
+    int region_edges_cap;
+    bool region_graph_stale;
+
+    // Points seen but not been to which can be walked or sailed on, each as cell id
+    int* frontier;
+    int frontier_num;
+
+    // Cost field of this decision, see struct cell, the queue holds cell id*4+direction
+    int field_id;
+    bool field_ready;
+    int* field_queue;
+
+    // Stone field of this decision, see struct cell, the deque holds cell ids
+    int stone_id;
+    bool stone_ready;
+    int* stone_queue;
+
+    // Labels of the last plan_search() and its open list, a bucket of labels for each f from plan_open_f. plan_items are the stones,
+    // dynamite and trees it tells apart as cell ids. A goal which failed is not searched again while the inventory
+    // is the one it failed with and the map did not change where it matters: for PLAN_WIN a point the search
+    // plan_fail_id got to or next to one, for PLAN_EXPLORE anywhere
+    PlanLabel plan_labels;
+    int plan_labels_num;
+    int plan_labels_cap;
+    int plan_open[PLAN_BUCKETS];
+    int plan_open_num;
+    int plan_open_f;
+    int plan_id;
+    int plan_items[PLAN_MAX_ITEMS];
+    int plan_items_num;
+    bool plan_failed[PLAN_GOALS];
+    int plan_fail_inventory[PLAN_GOALS];
+    int plan_fail_id;
+
+    // Open lists of A* for each side, the heuristic of the agent's searches (heuristic_turns unless agent_use_alt()),
+    // and all nodes created in a search, reused by the next search
+    int* astar_heap[2];
+    Heuristic astar_heuristic;
+    AstarNode astar_arena;
+    int astar_arena_size;
+    int astar_arena_cap;
+    int astar_search_id;
+
+    // D* Lite search from the goal of the plan, kept from move to move while the plan is followed.
+    // dstar_on if the plan is only moves to dstar_goal with dstar_passable (dstar_enter if the goal can be entered
+    // even when not passable), dstar_started once the search is made, dstar_dirty if the map changed since checked.
+    // dstar_last is where the agent was when dstar_km was last raised
+    bool dstar_on;
+    bool dstar_started;
+    bool dstar_dirty;
+    bool dstar_enter;
+    struct point dstar_goal;
+    int dstar_goal_id;
+    Passable dstar_passable;
+    int dstar_id;
+    int dstar_km;
+    struct point dstar_last;
+    struct dstarKey* dstar_heap;
+    int dstar_num;
+
+    // Landmarks of the ALT heuristic as cell ids, with the moves from them to every point alt_passable can pass in the
+    // part of the map they are in (and to the points next to it). Built again for a search when the map changed
+    // since (alt_dirty), with another Passable, or from a src they did not get to. The queue holds cell ids
+    int alt_landmarks[ALT_LANDMARKS];
+    int alt_num;
+    int alt_id;
+    int alt_visit;
+    bool alt_dirty;
+    Passable alt_passable;
+    int* alt_queue;
+};
+
 //*********************************************************************************************************************
 
 // Functions declared 
 
+// Free the lists of things seen
+void lists_free(Agent agent);
+
 // Initialise the map, which going to be used to memorize
-void map_init();
+void map_init(Agent agent);
+
+// Allocate the chunk of a point, and grow the window of chunks to take it
+void chunk_make(Agent agent, int x, int y);
+void chunk_dir_grow(Agent agent, int cx, int cy);
+
+// The cell of a point, NULL if not allocated / the unknown cell if not allocated, never written /
+// one which must be allocated
+struct cell* cell_find(Agent agent, int x, int y);
+const struct cell* cell_peek(Agent agent, int x, int y);
+struct cell* cell_at(Agent agent, int x, int y);
+
+// Cell id of an allocated point, and back
+int cell_id(Agent agent, int x, int y);
+struct cell* cell_of(Agent agent, int id);
+int cell_x(Agent agent, int id);
+int cell_y(Agent agent, int id);
 
 // Initialise the status at the begin of the game
-void status_init();
+void status_init(Agent agent);
 
-// Print current view
-void print_view();
+// Print a view
+void print_view(char env[5][5]);
 
 // Update status of map, tool, status based on view
-void update_status( char env[5][5] );
+void update_status( Agent agent, char env[5][5] );
 
-// Rotate the matrix environment(view)
-void rotate_view(char (*env)[5]);
+// Build the tables used by updata_map to put the view on the map
+void view_table_init(Agent agent);
 
-// Using the environment(view) to update map
-void updata_map(char (*env)[5]);
+// Using the environment(view) to update map, the points changed are listed in changed[]
+void updata_map(Agent agent, char (*env)[5]);
 
 // Add new discover tool to list
-void addTool(char a_tool, int x, int y);
+void addTool(Agent agent, char a_tool, int x, int y);
 
 // Delete tool that have been reached
-void deleteTool(char a_tool, int x, int y);
+void deleteTool(Agent agent, char a_tool, int x, int y);
 
 // Add new discover door to list
-void addDoor(int x, int y);
+void addDoor(Agent agent, int x, int y);
 
 // Delete door that have been opened
-void deleteDoor(int x, int y);
+void deleteDoor(Agent agent, int x, int y);
 
 // Add new discover tree to list
-void addTree(int x, int y);
+void addTree(Agent agent, int x, int y);
 
 // Delete tree that have been chopped
-void deleteTree(int x, int y);
+void deleteTree(Agent agent, int x, int y);
 
 // Add new discovered tree
-void addTreasure(int x, int y);
+void addTreasure(Agent agent, int x, int y);
 
 // Find the next destination and find a path to it
-int find_a_path( char* step );
+int find_a_path( Agent agent, Plan plan );
+
+// Get if accessable form src to dest, marking all accessable points
+bool is_accessable(Agent agent, int srcX, int srcY, int destX, int destY, bool transfer);
+
+// BFS from (x,y) to mark all points can reach as accessable
+void flood_fill(Agent agent, int x, int y, Passable passable, Passable transfer);
+
+// Whether the last flood_fill got to the point
+bool accessable(Agent agent, const struct cell* cell);
+
+// Passable functions for flood_fill
+bool passable_land(Agent agent, int x, int y);
+bool passable_sea(Agent agent, int x, int y);
+bool transfer_to_sea(Agent agent, int x, int y);
+bool transfer_to_land(Agent agent, int x, int y);
+
+// Update the region of a point after it changed
+void region_update(Agent agent, int x, int y);
+
+// Region kind a point should be in now
+char region_kind_of(Agent agent, int x, int y);
+
+// Make a point a new region and join it to its neighbors
+void region_add(Agent agent, int x, int y);
+
+// Union-find operations on point index cell_id(agent, x, y)
+int region_root(Agent agent, int p);
+void region_union(Agent agent, int p, int q);
+
+// Build the regions from scratch
+void region_rebuild(Agent agent);
+
+// Region label of a point, -1 if not in one
+int region_find(Agent agent, int x, int y);
+
+// Whether the agent can walk (or sail) to a point
+bool reachable(Agent agent, int x, int y);
+
+// Add or remove a point from the frontier after it changed
+void frontier_update(Agent agent, int x, int y);
+
+// Passable function of where the agent is
+Passable agent_passable(Agent agent);
 
-// Get if accessable form src to dest
-bool is_accessable(int srcX, int srcY, int destX, int destY, bool transfer);
+// Whether a point is next to the region label
+bool next_to_region(Agent agent, int x, int y, int label);
 
-// Recursive function to mark if a point is accessable from (x,y)
-void recursive_mark_access(int x, int y, char type);
+// Build the pairs of land and sea regions which are next to each other
+void region_graph_build(Agent agent);
 
-// Get if accessable form src to dest, works on different array
-bool is_accessable_2(int srcX, int srcY, int destX, int destY, bool transfer);
+// Whether land region and sea region are next to each other, and where
+bool region_landing(Agent agent, int land, int sea, struct point* at);
 
-// Recursive function to mark if a point is accessable from (x,y), works on different array
-void recursive_mark_access_2(int x, int y, char type);
+// Where the agent on sea can land to get to (x,y)
+bool find_landing(Agent agent, int x, int y, struct point* at);
+
+// Where the agent on land can go on sea to get to (x,y)
+bool find_crossing(Agent agent, int x, int y, struct point* at);
 
 // Open the neighbor door
-int open_door(char* steps);
+int open_door(Agent agent, Plan plan);
 
 // Chop the neighbor tree
-int chop_tree(char* steps);
+int chop_tree(Agent agent, Plan plan);
 
 // Get action to send to server
-char interpret_action(char* step, int curr_step);
+char interpret_action(Agent agent, Plan plan, int curr_step);
 
 
 // Help function*******************************************************************************************************
 
 // Print the map that have been seen
-void print_map();
+void print_map(Agent agent);
 
 // Heuristic function of two points on map
 int heuristic(int srcX, int srcY, int destX, int destY);
 
-// Whether availabe to pass lake by stones
-bool is_accessable_lake(int srcX, int srcY, int destX, int destY);
+// Get a path from src to dest, using A* search forward or bidirectional with a heuristic
+int get_path_a_star(Agent agent, int srcX, int srcY, int direction, int destX, int destY, Passable passable, int mode,
+                    Heuristic heuristic, Plan path);
+int astar_forward(Agent agent, int srcX, int srcY, int direction, int destX, int destY, Passable passable,
+                  Heuristic heuristic, Plan path);
+int astar_bidirectional(Agent agent, int srcX, int srcY, int direction, int destX, int destY, Passable passable,
+                        Heuristic heuristic, Plan path);
 
-// Get a path from src to dest, using A* search
-int get_path_a_star(int srcX, int srcY, int direction, int destX, int destY, char* path);
+// Push the states next to a node on its side of the search
+void astar_expand(Agent agent, AstarNodeHead queue, int curr, int srcX, int srcY, int destX, int destY, Passable passable,
+                  Heuristic heuristic, int search_id);
 
-// Print all tool
-void print_tool_list(void);
+// Heuristics of A*: the distance, the distance and the turns it takes at least facing dir, and the most of that and
+// the ALT bound from the landmarks
+int heuristic_manhattan(Agent agent, int side, int x, int y, int dir, int targetX, int targetY);
+int heuristic_turns(Agent agent, int side, int x, int y, int dir, int targetX, int targetY);
+int heuristic_alt(Agent agent, int side, int x, int y, int dir, int targetX, int targetY);
 
-// Print accessable from current point
-void print_accessible(void);
+// Make the ALT landmarks good for a search from src with passable, and the BFS from one of them
+void alt_prepare(Agent agent, Passable passable, int srcX, int srcY);
+int alt_bfs(Agent agent, int start, int k);
 
-// Print accessable from current point
-void print_accessible_2(void);
+// The node a side of the search got to a state with, -1 if not got there
+int astar_reached(Agent agent, AstarNodeHead queue, const struct cell* cell, int dir, int search_id);
 
-// Global variables****************************************************************************************************
+// Start an empty open list of a side / leave astar_index clean for the next search
+void astar_queue_init(Agent agent, AstarNodeHead queue, int side);
+void astar_queue_clear(Agent agent, AstarNodeHead queue);
+
+// Whether A* can step on a point
+bool astar_can_enter(Agent agent, Passable passable, int x, int y, int destX, int destY);
+
+// Create a node in the A* arena, return its index
+int astarNode_create(Agent agent, int x, int y, int direction, int g, int h, char act, int parent);
+
+// Push a node to the open list, or replace the open node in the same state if not worse
+void astarNode_insert(Agent agent, AstarNodeHead queue, int node);
+
+// Pop the node with the lowest f from the open list
+int astarNode_pop(Agent agent, AstarNodeHead queue);
+
+// Whether node a should be expanded before node b
+bool astarNode_before(Agent agent, int a, int b);
+
+// Restore heap order from slot i upwards / downwards
+void astarNode_sift_up(Agent agent, AstarNodeHead queue, int i);
+void astarNode_sift_down(Agent agent, AstarNodeHead queue, int i);
+
+// Cost field from the agent to every state, and reading it
+void field_build(Agent agent);
+bool field_visit(Agent agent, struct cell* cell, int dir, int dist, char act);
+int field_cost(Agent agent, int x, int y);
+int field_cell_cost(Agent agent, const struct cell* cell);
+int field_nearest_neighbor(Agent agent, int x, int y, struct point* at);
+int field_path(Agent agent, int x, int y, Plan plan);
+
+// Stone field from the agent, the cheapest target of a kind in it, and getting there: stone_go() walks to the shore
+// of the crossing and leaves the rest in go on lake state, stone_path() writes the crossing
+void stone_build(Agent agent);
+int stone_cost(Agent agent, int x, int y);
+bool stone_target(Agent agent, char type, struct point* at);
+int stone_go(Agent agent, int x, int y, Plan plan);
+int stone_path(Agent agent, int x, int y, Plan plan);
+
+// Plan to the goal (PLAN_WIN or PLAN_EXPLORE) over what is held and can be picked up on the way, return its length
+int plan_search(Agent agent, int goal, Plan plan);
+
+// The label after a move forward from a label, false if the move can not be made
+bool plan_step(Agent agent, const struct planLabel* from, struct planLabel* to);
+
+// Index of a point in plan_items, -1 if not one
+int plan_item(Agent agent, int id);
+
+// Index of a point in plan_items, made one if there is room, -1 if not
+int plan_item_add(Agent agent, int id);
+
+// A point of the map changed, forget the failed searches it can make succeed
+void plan_note(Agent agent, int x, int y);
+
+// Heuristic of a label for the goal
+int plan_h(Agent agent, int goal, const struct planLabel* label);
+
+// Whether label a is as cheap as b, holds at least as much and has used up nothing more
+bool plan_dominates(const struct planLabel* a, const struct planLabel* b);
+
+// Keep a label unless one at the same point and direction dominates it, and open it
+void plan_label_add(Agent agent, const struct planLabel* label);
+
+// Open list of plan_search(), lowest f first, the last pushed of the same f first
+void plan_push(Agent agent, int label);
+int plan_pop(Agent agent);
+
+// Follow the plan just made to (x,y) with D* Lite, and check it against each view: dstar_note() takes the changes of
+// a view, dstar_check() repairs the rest of the plan with them
+void dstar_track(Agent agent, int x, int y, Passable passable, bool enter);
+void dstar_note(Agent agent);
+void dstar_check(Agent agent);
+
+// Make the search from the goal, bring it up to date with the agent and the map
+void dstar_start(Agent agent);
+void dstar_compute(Agent agent);
+
+// Recompute the lookahead of a state and put it in the open list if it is not consistent
+void dstar_update(Agent agent, int state);
+
+// Cheapest move from a state with the search, its cost and the state and action of it
+int dstar_best(Agent agent, int state, int* next, char* act);
+
+// States one action before a state, return how many
+int dstar_preds(Agent agent, int state, int* preds);
+
+// Cost to the goal of a state, DSTAR_INF if not known
+int dstar_g(Agent agent, int state);
+
+// Make a state part of this search if it is not yet
+void dstar_touch(Agent agent, struct cell* cell, int dir);
+
+// Whether the plan can step on a point
+bool dstar_can_enter(Agent agent, int x, int y);
+
+// Key of a state now
+void dstar_key(Agent agent, int state, struct dstarKey* key);
+
+// Open list of D* Lite, a binary min-heap of keys
+bool dstar_before(const struct dstarKey* a, const struct dstarKey* b);
+void dstar_push(Agent agent, int state);
+void dstar_remove(Agent agent, int i);
+void dstar_sift_up(Agent agent, int i);
+void dstar_sift_down(Agent agent, int i);
+
+// Length of the rest of the plan if it still gets to the goal, -1 if not
+int plan_remaining(Agent agent);
+
+// Make sure the plan can hold n steps, and return the buffer
+char* plan_reserve(Plan plan, int n);
 
-int   pipe_fd;
-FILE* in_stream;
-FILE* out_stream;
+// Print all tool
+void print_tool_list(Agent agent);
+
+// Print accessable points
+void print_accessible(Agent agent);
 
-char view[5][5];
-char map[MAP_SIZE][MAP_SIZE];
-bool accessable[MAP_SIZE][MAP_SIZE];
-bool accessable_2[MAP_SIZE][MAP_SIZE];
-bool seen[MAP_SIZE][MAP_SIZE];
-bool been[MAP_SIZE][MAP_SIZE];
-struct Status status;
+// Cycle counter for the stats timers
+unsigned long long stats_clock(void);
+
+// Global variables****************************************************************************************************
 
-Tool tool_list;
-Door door_list;
-Tree tree_list;
-struct point* Treasure;
+// Moving one step forward in each direction, the same for every agent
+const int dir_dx[4] = { 0, 1, 0, -1 };
+const int dir_dy[4] = { -1, 0, 1, 0 };
 
-bool go_on_lake;
-int stoneX;
-int stoneY;
+// What is known of a point never seen: nothing
+const struct cell unknown_cell = { .map = '.', .region_kind = REGION_NONE, .region_parent = -1, .region_edge_head = -1 };
 
 //*********************************************************************************************************************
 
+#ifndef AGENT_NO_MAIN
 int main( int argc, char *argv[] )
 {
+    struct transport engine_link;
+    char view[5][5];
     char action;
-    int sd;
-    int ch;
-    int i,j;
+    Agent agent;
 
-    if ( argc < 3 ) {
-        printf("Usage: %s -p port\n", argv[0] );
+    // open connection to Game Engine
+    if ( !transport_open( &engine_link, argc, argv ) ) {
+        printf("Usage: %s -p port [-h host] | -u path | -f fd | -s  [-b] [-d]\n", argv[0] );
         exit(1);
     }
 
-    // open socket to Game Engine
-    sd = tcpopen("localhost", atoi( argv[2] ));
-
-    pipe_fd    = sd;
-    in_stream  = fdopen(sd,"r");
-    out_stream = fdopen(sd,"w");
-
-    map_init();
-    
-    status_init();
-
-    char* steps = (char*)malloc(200); 
-
-    int num_of_steps=0;
-    int curr_step=0;
+    agent = agent_create();
+    if(agent==NULL) exit(1);
+    agent_init( agent );
 
-    while(1) 
+    if(engine_link.batch)
     {
-        // scan 5-by-5 wintow around current location
-        for( i=0; i < 5; i++ ) 
+        // Send the rest of the plan at once, get back a view for each action the engine took
+        static char views[PIPE_BATCH_MAX][5][5];
+        const char* actions;
+        int n;
+
+        if(pipe_read_view( &engine_link, view )) 
         {
-            for( j=0; j < 5; j++ ) 
+            agent_observe( agent, view );
+            while(1)
             {
-                if( !(( i == 2 )&&( j == 2 ))) 
+                n = agent_pending( agent, &actions );
+                if(n==0) 
                 {
-                    ch = getc( in_stream );
-                    if( ch == -1 ) {
-                        exit(1);
-                    }
-                    view[i][j] = ch;
+                    agent_stats_dump(agent, stderr, NULL);
+#ifdef AGENT_STATS
+                    pipe_stats_print(&engine_link, stderr);
+#endif
+                    while(1);
                 }
+                if(!pipe_send_actions( &engine_link, actions, MIN(n, PIPE_BATCH_MAX) )) break;
+                n = pipe_read_views( &engine_link, views );
+                if(n==0) break;
+                agent_observe_batch( agent, views, n );
             }
         }
-
-        //print_view(); // COMMENT THIS OUT BEFORE SUBMISSION
-
-        update_status( view );
-
-        if(curr_step>=num_of_steps)
-        {
-            num_of_steps = find_a_path( steps );
-            curr_step = 0;
-        }
-
-        if(num_of_steps==0) 
+    }
+    else
+    {
+        // One recv for each view and one send for each action
+        while(pipe_read_view( &engine_link, view )) 
         {
-            //print_map();
-            while(1);
-            break;
-        }
-
+            //print_view( view ); // COMMENT THIS OUT BEFORE SUBMISSION
 
-        action = interpret_action(steps, curr_step);
-        curr_step++;
+            action = agent_act( agent, view );
 
+            if(action==0) 
+            {
+                agent_stats_dump(agent, stderr, NULL);
+#ifdef AGENT_STATS
+                pipe_stats_print(&engine_link, stderr);
+#endif
+                //print_map(agent);
+                while(1);
+                break;
+            }
 
-        putc( action, out_stream );
-        fflush( out_stream );
+            if(!pipe_send_action( &engine_link, action )) break;
+        }
     }
 
+    // Server closed the connection, the game is over
+    agent_stats_dump(agent, stderr, NULL);
+#ifdef AGENT_STATS
+    pipe_stats_print(&engine_link, stderr);
+#endif
+    exit(1);
+
     return 0;
 }
+#endif
 
-
-void map_init()
+Agent agent_create(void)
 {
-    int i,j;
-    for(i=0; i<MAP_SIZE; ++i)
+    // Zero is an empty game: no lists, no buffers, no plan
+    Agent agent = calloc(1, sizeof(struct agent));
+    if(agent==NULL) return NULL;
+
+    // A window of chunks around the start, it grows when the map does
+    agent->dir_w = CHUNK_DIR_START;
+    agent->dir_h = CHUNK_DIR_START;
+    agent->dir_x = (START_POINT>>CHUNK_SHIFT)-CHUNK_DIR_START/2;
+    agent->dir_y = (START_POINT>>CHUNK_SHIFT)-CHUNK_DIR_START/2;
+    agent->chunk_dir = malloc(CHUNK_DIR_START*CHUNK_DIR_START*sizeof(int));
+    if(agent->chunk_dir==NULL)
     {
-        for (j=0; j<MAP_SIZE; ++j)
-        {
-            map[i][j]='.';
-            seen[i][j]=false;
-            been[i][j]=false;
-        }
+        free(agent);
+        return NULL;
     }
+    agent->astar_heuristic = heuristic_turns;
+    return agent;
 }
 
-// Initialise the status at the begin of the game
-void status_init()
-{
-    status.pos.x=START_POINT;
-    status.pos.y=START_POINT;
-    status.direction = SOUTH;
-    status.key = false;
-    status.axe = false;
-    status.treasure = false;
-    status.raft = false;
-    status.num_stone = 0;
-    status.a.x=START_POINT-2;
-    status.a.y=START_POINT-2;
-    status.b.x=START_POINT+2;
-    status.b.y=START_POINT+2;
-    status.been_to_sea = false;
-    tool_list = NULL;
-    door_list = NULL;
-    tree_list = NULL;
-    Treasure = NULL;
-    go_on_lake=false;    
-}
-
-// Print current view
-void print_view()
+void agent_use_alt(Agent agent, int on)
 {
-    int i,j;
-
-    printf("\n+-----+\n");
-    for( i=0; i < 5; i++ ) {
-        putchar('|');
-        for( j=0; j < 5; j++ ) {
-            if(( i == 2 )&&( j == 2 )) {
-                putchar( '^' );
-            }
-            else {
-                putchar( view[i][j] );
-            }
-        }
-        printf("|\n");
-    }
-    printf("+-----+\n");
+    agent->astar_heuristic = on ? heuristic_alt : heuristic_turns;
 }
 
-void update_status( char env[5][5] )
+void agent_free(Agent agent)
 {
-    rotate_view(env);
-    updata_map(env);
+    int i;
+    if(agent==NULL) return;
+    lists_free(agent);
+    for(i=0; i<agent->chunks_alloc; ++i)
+    {
+        free(agent->chunks[i]);
+    }
+    free(agent->chunks);
+    free(agent->chunk_dir);
+    free(agent->flood_queue);
+    free(agent->frontier);
+    free(agent->field_queue);
+    free(agent->stone_queue);
+    free(agent->astar_heap[ASTAR_FROM_SRC]);
+    free(agent->astar_heap[ASTAR_FROM_DEST]);
+    free(agent->dstar_heap);
+    free(agent->alt_queue);
+    free(agent->agent_plan.steps);
+    free(agent->region_edges);
+    free(agent->astar_arena);
+    free(agent->plan_labels);
+    free(agent);
 }
 
-// Rotate the matrix environment(view)
-void rotate_view(char (*env)[5])
+// Free the tools, doors, trees and treasure seen in the last game
+void lists_free(Agent agent)
 {
-    int i,j;
-    if(status.direction==NORTH)
+    while(agent->tool_list!=NULL)
     {
-        // Do not need rotate
+        Tool next = agent->tool_list->next;
+        free(agent->tool_list);
+        agent->tool_list = next;
     }
-    else if(status.direction==EAST)
+    while(agent->door_list!=NULL)
     {
-        char temp;
-        // i starts from 1 to skip first row
-        for (i = 1; i < 5; ++i) {
-            for (j = 0; j < i; ++j) {
-                temp = env[i][j];
-                env[i][j] = env[j][i];
-                env[j][i] = temp;
-            }
-        }
-        // Switch in each row
-        for (i = 0; i < 5; ++i) {
-            temp = env[i][0];
-            env[i][0] = env[i][4];
-            env[i][4] = temp;
-            temp = env[i][1];
-            env[i][1] = env[i][3];
-            env[i][3] = temp;
-        }
-    }
-    else if(status.direction==SOUTH)
-    {
-        char temp;
-        // Switch in each row
-        for (i = 0; i < 5; ++i) {
-            temp = env[i][0];
-            env[i][0] = env[i][4];
-            env[i][4] = temp;
-            temp = env[i][1];
-            env[i][1] = env[i][3];
-            env[i][3] = temp;
-        }
-        // Switch in each col
-        for (i = 0; i < 5; ++i) {
-            temp = env[0][i];
-            env[0][i] = env[4][i];
-            env[4][i] = temp;
-            temp = env[1][i];
-            env[1][i] = env[3][i];
-            env[3][i] = temp;
-        }
-    }
-    else if(status.direction==WEST)
-    {
-        char temp;
-        // i starts from 1 to skip first row
-        for (i = 1; i < 5; ++i) {
-            for (j = 0; j < i; ++j) {
-                temp = env[i][j];
-                env[i][j] = env[j][i];
-                env[j][i] = temp;
-            }
-        }
-        // Switch in each col
-        for (i = 0; i < 5; ++i) {
-            temp = env[0][i];
-            env[0][i] = env[4][i];
-            env[4][i] = temp;
-            temp = env[1][i];
-            env[1][i] = env[3][i];
-            env[3][i] = temp;
-        }
+        Door next = agent->door_list->next;
+        free(agent->door_list);
+        agent->door_list = next;
     }
-    else
+    while(agent->tree_list!=NULL)
     {
-        //printf("Error occur in direction\n");
+        Tree next = agent->tree_list->next;
+        free(agent->tree_list);
+        agent->tree_list = next;
     }
+    free(agent->Treasure);
+    agent->Treasure = NULL;
 }
 
-// Using the environment(view) to update map
-void updata_map(char (*env)[5])
+// Forget everything about the last game, also free the lists it left
+void agent_init(Agent agent)
 {
-    int i,j;
-    for(i=0; i<5; ++i)
-    {
-        for(j=0; j<5; ++j)
-        {
-            if(i==2&&j==2) 
-            {
-                deleteTool(map[status.pos.y][status.pos.x], status.pos.x, status.pos.y);
-                if(map[status.pos.y][status.pos.x]=='$') status.treasure=true;
-                been[status.pos.y][status.pos.x]=true;
-                continue;
-            }
-            
-            map[status.pos.y+i-2][status.pos.x+j-2] = env[i][j];
-            seen[status.pos.y+i-2][status.pos.x+j-2] = true;
-
-            status.a.x=MIN(status.a.x, status.pos.x+j-2);
-            status.a.y=MIN(status.a.y, status.pos.y+i-2);
-            status.b.x=MAX(status.b.x, status.pos.x+j-2);
-            status.b.y=MAX(status.b.y, status.pos.y+i-2);
-
-            if(    map[status.pos.y+i-2][status.pos.x+j-2] == 'a' 
-                || map[status.pos.y+i-2][status.pos.x+j-2] == 'k'
-                || map[status.pos.y+i-2][status.pos.x+j-2] == 'o')
-            {
-                addTool(map[status.pos.y+i-2][status.pos.x+j-2], status.pos.x+j-2, status.pos.y+i-2);
-            }
+    lists_free(agent);
 
-            if(map[status.pos.y+i-2][status.pos.x+j-2] == '-')
-            {
-                addDoor(status.pos.x+j-2, status.pos.y+i-2);
-            }
+    map_init(agent);
+    
+    status_init(agent);
+
+    agent->frontier_num = 0;
+    agent->field_ready = false;
+    agent->stone_ready = false;
+    agent->plan_failed[PLAN_WIN] = agent->plan_failed[PLAN_EXPLORE] = false;
+    agent->alt_dirty = true;
+    agent->dstar_on = false;
+    agent->num_of_steps = 0;
+    agent->curr_step = 0;
+    agent->plan_ns = 0;
+#ifdef AGENT_STATS
+    memset(&agent->stats, 0, sizeof(agent->stats));
+#endif
+}
 
-            if(map[status.pos.y+i-2][status.pos.x+j-2] == 'T')
-            {
-                addTree(status.pos.x+j-2, status.pos.y+i-2);
-            }
+long long agent_plan_ns(Agent agent)
+{
+    return agent->plan_ns;
+}
 
-            if(map[status.pos.y+i-2][status.pos.x+j-2] == '$')
-            {
-                addTreasure(status.pos.x+j-2, status.pos.y+i-2);
-            }
-        }
-    }
+char agent_act(Agent agent, char env[5][5])
+{
+    const char* actions;
+
+    agent_observe( agent, env );
+
+    if(agent_pending( agent, &actions )==0) return 0;
+
+    return agent_step(agent);
 }
 
-void addTool(char a_tool, int x, int y)
+void agent_observe(Agent agent, char env[5][5])
 {
-    Tool curr = tool_list;
-    Tool prev;
-    while(curr!=NULL)
+    update_status( agent, env );
+    dstar_note( agent );
+    dstar_check( agent );
+}
+
+int agent_pending(Agent agent, const char** actions)
+{
+    if(agent->curr_step>=agent->num_of_steps)
     {
-        if(curr->type==a_tool && curr->x==x && curr->y==y) return;
-        prev=curr;
-        curr=curr->next;
+        struct timespec begin, end;
+        STAT_TIMER_START(cycles);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        agent->dstar_on = false;
+        agent->num_of_steps = find_a_path( agent, &agent->agent_plan );
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        STAT_TIMER_STOP(find_a_path_cycles, cycles);
+        STAT_ADD(decisions, 1);
+        agent->plan_ns += (end.tv_sec-begin.tv_sec)*1000000000LL+(end.tv_nsec-begin.tv_nsec);
+        agent->curr_step = 0;
     }
-    
-    Tool new_tool = malloc(sizeof(struct tool));
-    new_tool->type = a_tool;
-    new_tool->x=x;
-    new_tool->y=y;
-    new_tool->next = NULL;
 
-    if(tool_list==NULL)
+    *actions = agent->agent_plan.steps+agent->curr_step;
+    return agent->num_of_steps-agent->curr_step;
+}
+
+char agent_step(Agent agent)
+{
+    return interpret_action(agent, &agent->agent_plan, agent->curr_step++);
+}
+
+void agent_observe_batch(Agent agent, char views[][5][5], int n)
+{
+    int i;
+    // Same order as one at a time, each action is taken and then the view it gave is seen. The engine took the
+    // actions of the plan as it was, so it is only repaired after the last one
+    for(i=0; i<n; ++i)
     {
-        tool_list=new_tool;
+        agent_step(agent);
+        update_status(agent, views[i]);
+        dstar_note(agent);
     }
-    else
+    dstar_check(agent);
+}
+
+
+void map_init(Agent agent)
+{
+    int i;
+    view_table_init(agent);
+    // Nothing seen yet, the chunks allocated are kept for the cells of this game
+    agent->chunks_num = 0;
+    for(i=0; i<agent->dir_w*agent->dir_h; ++i)
     {
-        prev->next = new_tool;
+        agent->chunk_dir[i] = -1;
     }
 }
 
-void deleteTool(char a_tool, int x, int y)
+// Allocate the chunk of (x,y) if it is not yet, and make room for its points in the per cell arrays
+void chunk_make(Agent agent, int x, int y)
 {
-    if(tool_list==NULL) return;
+    int cx = x>>CHUNK_SHIFT;
+    int cy = y>>CHUNK_SHIFT;
+    int k;
 
-    if(a_tool=='k') status.key=true;
-    else if(a_tool=='a') status.axe=true;  
-    else if(a_tool=='o') 
+    if(cx<agent->dir_x || cx>=agent->dir_x+agent->dir_w || cy<agent->dir_y || cy>=agent->dir_y+agent->dir_h)
     {
-        status.num_stone++;
-        map[status.pos.y][status.pos.x]=' ';  
+        chunk_dir_grow(agent, cx, cy);
     }
-    Tool curr = tool_list;
-    Tool prev = tool_list;
+    int* slot = &agent->chunk_dir[(cy-agent->dir_y)*agent->dir_w+cx-agent->dir_x];
+    if(*slot>=0) return;
 
-    while(curr!=NULL)
+    if(agent->chunks_num==agent->chunks_alloc)
     {
-        if(curr->type==a_tool && curr->x==x && curr->y==y) break;
-        prev=curr;
-        curr=curr->next;
+        if(agent->chunks_alloc==agent->chunks_cap)
+        {
+            agent->chunks_cap = MAX(2*agent->chunks_cap, 16);
+            agent->chunks = realloc(agent->chunks, agent->chunks_cap*sizeof(Chunk));
+            assert(agent->chunks!=NULL);
+        }
+        agent->chunks[agent->chunks_alloc] = malloc(sizeof(struct chunk));
+        assert(agent->chunks[agent->chunks_alloc]!=NULL);
+        agent->chunks_alloc++;
     }
-
-    if(curr==tool_list)
+    Chunk chunk = agent->chunks[agent->chunks_num];
+    chunk->x = cx*CHUNK_SIZE;
+    chunk->y = cy*CHUNK_SIZE;
+    for(k=0; k<CHUNK_CELLS; ++k)
     {
-        tool_list = curr->next;
-        free(curr);
-        return;
+        chunk->cells[k] = unknown_cell;
     }
+    *slot = agent->chunks_num++;
 
-    if(curr==NULL) return;
-
-    prev->next = curr->next;
-    free(curr);
+    // Every point is in these at most once (or once per direction)
+    if(agent->chunks_num*CHUNK_CELLS>agent->cells_cap)
+    {
+        agent->cells_cap = MAX(2*agent->cells_cap, agent->chunks_num*CHUNK_CELLS);
+        agent->flood_queue = realloc(agent->flood_queue, agent->cells_cap*sizeof(int));
+        agent->frontier = realloc(agent->frontier, agent->cells_cap*sizeof(int));
+        agent->field_queue = realloc(agent->field_queue, agent->cells_cap*4*sizeof(int));
+        agent->stone_queue = realloc(agent->stone_queue, agent->cells_cap*2*sizeof(int));
+        agent->astar_heap[ASTAR_FROM_SRC] = realloc(agent->astar_heap[ASTAR_FROM_SRC], agent->cells_cap*4*sizeof(int));
+        agent->astar_heap[ASTAR_FROM_DEST] = realloc(agent->astar_heap[ASTAR_FROM_DEST], agent->cells_cap*4*sizeof(int));
+        agent->dstar_heap = realloc(agent->dstar_heap, agent->cells_cap*4*sizeof(struct dstarKey));
+        agent->alt_queue = realloc(agent->alt_queue, agent->cells_cap*sizeof(int));
+        assert(agent->flood_queue!=NULL && agent->frontier!=NULL && agent->field_queue!=NULL
+               && agent->stone_queue!=NULL && agent->astar_heap[ASTAR_FROM_SRC]!=NULL
+               && agent->astar_heap[ASTAR_FROM_DEST]!=NULL && agent->dstar_heap!=NULL && agent->alt_queue!=NULL);
+    }
 }
 
-void addDoor(int x, int y)
+// Make the chunk window take chunk (cx,cy), growing at least by its size on that side so a long walk does not
+// copy it again for every chunk
+void chunk_dir_grow(Agent agent, int cx, int cy)
 {
-    Door curr = door_list;
+    int x0 = agent->dir_x;
+    int y0 = agent->dir_y;
+    int x1 = x0+agent->dir_w;
+    int y1 = y0+agent->dir_h;
+    int i,j;
+
+    if(cx<x0) x0 = MIN(cx, x0-agent->dir_w);
+    if(cx>=x1) x1 = MAX(cx+1, x1+agent->dir_w);
+    if(cy<y0) y0 = MIN(cy, y0-agent->dir_h);
+    if(cy>=y1) y1 = MAX(cy+1, y1+agent->dir_h);
+
+    int* dir = malloc((x1-x0)*(y1-y0)*sizeof(int));
+    assert(dir!=NULL);
+    for(i=0; i<(x1-x0)*(y1-y0); ++i)
+    {
+        dir[i] = -1;
+    }
+    for(i=0; i<agent->dir_h; ++i)
+    {
+        for(j=0; j<agent->dir_w; ++j)
+        {
+            dir[(agent->dir_y+i-y0)*(x1-x0)+agent->dir_x+j-x0] = agent->chunk_dir[i*agent->dir_w+j];
+        }
+    }
+    free(agent->chunk_dir);
+    agent->chunk_dir = dir;
+    agent->dir_x = x0;
+    agent->dir_y = y0;
+    agent->dir_w = x1-x0;
+    agent->dir_h = y1-y0;
+}
+
+struct cell* cell_find(Agent agent, int x, int y)
+{
+    unsigned cx = (x>>CHUNK_SHIFT)-agent->dir_x;
+    unsigned cy = (y>>CHUNK_SHIFT)-agent->dir_y;
+    int id;
+
+    if(cx>=(unsigned)agent->dir_w || cy>=(unsigned)agent->dir_h) return NULL;
+    id = agent->chunk_dir[cy*agent->dir_w+cx];
+    if(id<0) return NULL;
+    return &agent->chunks[id]->cells[((y&CHUNK_MASK)<<CHUNK_SHIFT)|(x&CHUNK_MASK)];
+}
+
+const struct cell* cell_peek(Agent agent, int x, int y)
+{
+    const struct cell* cell = cell_find(agent, x, y);
+    return cell!=NULL ? cell : &unknown_cell;
+}
+
+struct cell* cell_at(Agent agent, int x, int y)
+{
+    struct cell* cell = cell_find(agent, x, y);
+    assert(cell!=NULL);
+    return cell;
+}
+
+int cell_id(Agent agent, int x, int y)
+{
+    int id = agent->chunk_dir[((y>>CHUNK_SHIFT)-agent->dir_y)*agent->dir_w+(x>>CHUNK_SHIFT)-agent->dir_x];
+    return (id<<CHUNK_ID_SHIFT)+(((y&CHUNK_MASK)<<CHUNK_SHIFT)|(x&CHUNK_MASK));
+}
+
+struct cell* cell_of(Agent agent, int id)
+{
+    return &agent->chunks[id>>CHUNK_ID_SHIFT]->cells[id&(CHUNK_CELLS-1)];
+}
+
+int cell_x(Agent agent, int id)
+{
+    return agent->chunks[id>>CHUNK_ID_SHIFT]->x+(id&CHUNK_MASK);
+}
+
+int cell_y(Agent agent, int id)
+{
+    return agent->chunks[id>>CHUNK_ID_SHIFT]->y+((id>>CHUNK_SHIFT)&CHUNK_MASK);
+}
+
+// Initialise the status at the begin of the game
+void status_init(Agent agent)
+{
+    agent->status.pos.x=START_POINT;
+    agent->status.pos.y=START_POINT;
+    agent->status.direction = SOUTH;
+    agent->status.key = false;
+    agent->status.axe = false;
+    agent->status.treasure = false;
+    agent->status.raft = false;
+    agent->status.num_stone = 0;
+    agent->status.num_dynamite = 0;
+    agent->status.a.x=START_POINT-2;
+    agent->status.a.y=START_POINT-2;
+    agent->status.b.x=START_POINT+2;
+    agent->status.b.y=START_POINT+2;
+    agent->status.been_to_sea = false;
+    agent->tool_list = NULL;
+    agent->door_list = NULL;
+    agent->tree_list = NULL;
+    agent->Treasure = NULL;
+    agent->go_on_lake=false;    
+    agent->region_dirty=false;
+    agent->region_graph_stale=true;
+}
+
+// Print a view
+void print_view(char env[5][5])
+{
+    int i,j;
+
+    printf("\n+-----+\n");
+    for( i=0; i < 5; i++ ) {
+        putchar('|');
+        for( j=0; j < 5; j++ ) {
+            if(( i == 2 )&&( j == 2 )) {
+                putchar( '^' );
+            }
+            else {
+                putchar( env[i][j] );
+            }
+        }
+        printf("|\n");
+    }
+    printf("+-----+\n");
+}
+
+void update_status( Agent agent, char env[5][5] )
+{
+    updata_map(agent, env);
+}
+
+// Rotate the matrix environment(view)
+// Which view cell goes to each point around the agent, for each direction the agent can face
+void view_table_init(Agent agent)
+{
+    int dir, a, b;
+    for(a=0; a<5; ++a)
+    {
+        for(b=0; b<5; ++b)
+        {
+            agent->view_dx[a*5+b] = b-2;
+            agent->view_dy[a*5+b] = a-2;
+        }
+    }
+    // View row a is 2-a steps ahead, column b is b-2 steps to the right
+    for(dir=NORTH; dir<=WEST; ++dir)
+    {
+        int right = (dir+1)%4;
+        for(a=0; a<5; ++a)
+        {
+            for(b=0; b<5; ++b)
+            {
+                int dx = (2-a)*dir_dx[dir]+(b-2)*dir_dx[right];
+                int dy = (2-a)*dir_dy[dir]+(b-2)*dir_dy[right];
+                agent->view_index[dir][(dy+2)*5+dx+2] = a*5+b;
+            }
+        }
+    }
+}
+
+// Using the environment(view) to update map
+void updata_map(Agent agent, char (*env)[5])
+{
+    const char* in = &env[0][0];
+    const int* index = agent->view_index[agent->status.direction];
+    int k;
+
+    // The chunks of the view and of the points next to it, so every point next to a known one is allocated
+    for(k=0; k<4; ++k)
+    {
+        chunk_make(agent, agent->status.pos.x+(k&1 ? 3 : -3), agent->status.pos.y+(k&2 ? 3 : -3));
+    }
+
+    agent->changed_num = 0;
+    for(k=0; k<25; ++k)
+    {
+        int x = agent->status.pos.x+agent->view_dx[k];
+        int y = agent->status.pos.y+agent->view_dy[k];
+
+        if(k==12) 
+        {
+            deleteTool(agent, cell_peek(agent, x, y)->map, x, y);
+            if(cell_peek(agent, x, y)->map=='$') agent->status.treasure=true;
+            cell_at(agent, x, y)->been=true;
+            region_update(agent, x, y);
+            frontier_update(agent, x, y);
+            continue;
+        }
+
+        // Same as last time it was seen, nothing to update
+        char c = in[index[k]];
+        if(cell_peek(agent, x, y)->seen && cell_peek(agent, x, y)->map==c) continue;
+
+        cell_at(agent, x, y)->map = c;
+        plan_note(agent, x, y);
+        agent->alt_dirty = true;
+        agent->changed[agent->changed_num].x = x;
+        agent->changed[agent->changed_num].y = y;
+        agent->changed_num++;
+
+        if(!cell_peek(agent, x, y)->seen)
+        {
+            cell_at(agent, x, y)->seen = true;
+            agent->status.a.x=MIN(agent->status.a.x, x);
+            agent->status.a.y=MIN(agent->status.a.y, y);
+            agent->status.b.x=MAX(agent->status.b.x, x);
+            agent->status.b.y=MAX(agent->status.b.y, y);
+        }
+        region_update(agent, x, y);
+        frontier_update(agent, x, y);
+
+        if(c == 'a' || c == 'k' || c == 'o' || c == 'd')
+        {
+            addTool(agent, c, x, y);
+        }
+        else if(c == '-')
+        {
+            addDoor(agent, x, y);
+        }
+        else if(c == 'T')
+        {
+            addTree(agent, x, y);
+        }
+        else if(c == '$')
+        {
+            addTreasure(agent, x, y);
+        }
+    }
+}
+
+void addTool(Agent agent, char a_tool, int x, int y)
+{
+    Tool curr = agent->tool_list;
+    Tool prev;
+    while(curr!=NULL)
+    {
+        if(curr->type==a_tool && curr->x==x && curr->y==y) return;
+        prev=curr;
+        curr=curr->next;
+    }
+    
+    Tool new_tool = malloc(sizeof(struct tool));
+    new_tool->type = a_tool;
+    new_tool->x=x;
+    new_tool->y=y;
+    new_tool->next = NULL;
+
+    if(agent->tool_list==NULL)
+    {
+        agent->tool_list=new_tool;
+    }
+    else
+    {
+        prev->next = new_tool;
+    }
+}
+
+void deleteTool(Agent agent, char a_tool, int x, int y)
+{
+    if(agent->tool_list==NULL) return;
+
+    if(a_tool=='k') agent->status.key=true;
+    else if(a_tool=='a') agent->status.axe=true;  
+    else if(a_tool=='o') 
+    {
+        agent->status.num_stone++;
+        cell_at(agent, agent->status.pos.x, agent->status.pos.y)->map=' ';  
+    }
+    else if(a_tool=='d')
+    {
+        agent->status.num_dynamite++;
+        cell_at(agent, agent->status.pos.x, agent->status.pos.y)->map=' ';
+    }
+    Tool curr = agent->tool_list;
+    Tool prev = agent->tool_list;
+
+    while(curr!=NULL)
+    {
+        if(curr->type==a_tool && curr->x==x && curr->y==y) break;
+        prev=curr;
+        curr=curr->next;
+    }
+
+    if(curr==agent->tool_list)
+    {
+        agent->tool_list = curr->next;
+        free(curr);
+        return;
+    }
+
+    if(curr==NULL) return;
+
+    prev->next = curr->next;
+    free(curr);
+}
+
+void addDoor(Agent agent, int x, int y)
+{
+    Door curr = agent->door_list;
     Door prev;
     while(curr!=NULL)
     {
@@ -727,9 +1584,9 @@ void addDoor(int x, int y)
     new_door->y=y;
     new_door->next = NULL;
 
-    if(door_list==NULL)
+    if(agent->door_list==NULL)
     {
-        door_list=new_door;
+        agent->door_list=new_door;
     }
     else
     {
@@ -737,12 +1594,12 @@ void addDoor(int x, int y)
     }
 }
 
-void deleteDoor(int x, int y)
+void deleteDoor(Agent agent, int x, int y)
 {
-    assert(door_list!=NULL);
+    assert(agent->door_list!=NULL);
 
-    Door curr = door_list;
-    Door prev = door_list;
+    Door curr = agent->door_list;
+    Door prev = agent->door_list;
 
     while(curr!=NULL)
     {
@@ -751,9 +1608,9 @@ void deleteDoor(int x, int y)
         curr=curr->next;
     }
 
-    if(curr==door_list)
+    if(curr==agent->door_list)
     {
-        door_list = curr->next;
+        agent->door_list = curr->next;
         free(curr);
         return;
     }
@@ -764,9 +1621,9 @@ void deleteDoor(int x, int y)
     free(curr);
 }
 
-void addTree(int x, int y)
+void addTree(Agent agent, int x, int y)
 {
-    Tree curr = tree_list;
+    Tree curr = agent->tree_list;
     Tree prev;
     while(curr!=NULL)
     {
@@ -780,9 +1637,9 @@ void addTree(int x, int y)
     new_tree->y=y;
     new_tree->next = NULL;
 
-    if(tree_list==NULL)
+    if(agent->tree_list==NULL)
     {
-        tree_list=new_tree;
+        agent->tree_list=new_tree;
     }
     else
     {
@@ -790,12 +1647,12 @@ void addTree(int x, int y)
     }    
 }
 
-void deleteTree(int x, int y)
+void deleteTree(Agent agent, int x, int y)
 {
-    assert(tree_list!=NULL);
+    assert(agent->tree_list!=NULL);
 
-    Tree curr = tree_list;
-    Tree prev = tree_list;
+    Tree curr = agent->tree_list;
+    Tree prev = agent->tree_list;
 
     while(curr!=NULL)
     {
@@ -804,9 +1661,9 @@ void deleteTree(int x, int y)
         curr=curr->next;
     }
 
-    if(curr==tree_list)
+    if(curr==agent->tree_list)
     {
-        tree_list = curr->next;
+        agent->tree_list = curr->next;
         free(curr);
         return;
     }
@@ -817,310 +1674,251 @@ void deleteTree(int x, int y)
     free(curr);
 }
 
-void addTreasure(int x, int y)
+void addTreasure(Agent agent, int x, int y)
 {
-    if(Treasure!=NULL) return;
-    Treasure = malloc(sizeof(struct point));
-    Treasure->x=x;
-    Treasure->y=y;
+    if(agent->Treasure!=NULL) return;
+    agent->Treasure = malloc(sizeof(struct point));
+    agent->Treasure->x=x;
+    agent->Treasure->y=y;
 }
 
-int find_a_path( char* steps )
+int find_a_path( Agent agent, Plan plan )
 {
-    int ret=0, i, j, m, n;
+    int ret=0, i, j;
+    struct point near = { 0, 0 };
 
-    if(go_on_lake)
+    // Agent moved since last decision
+    agent->field_ready=false;
+    agent->stone_ready=false;
+
+    // Cross on stones, unless what was seen on the way to the shore makes it take more than we have
+    if(agent->go_on_lake)
     {
-        for (i = 0; i < MAP_SIZE; ++i)
+        agent->go_on_lake=false;
+        int cost = stone_cost(agent, agent->stoneX, agent->stoneY);
+        if(cost!=-1 && cost<=agent->status.num_stone)
         {
-            for(j=0; j < MAP_SIZE; ++j)
-            {
-                accessable[i][j]=true;
-            }
+            ret = stone_path(agent, agent->stoneX, agent->stoneY, plan);
+            STAT_BRANCH(BRANCH_GO_ON_LAKE);
+            if(ret>0) return ret;
         }
-        ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, stoneX, stoneY, steps);
-        go_on_lake=false;
-        return ret;            
     }
 
-    is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-
+    // The whole way to the treasure and back if the known map has it
+    if(agent->Treasure!=NULL || agent->status.treasure)
+    {
+        ret = plan_search(agent, PLAN_WIN, plan);
+        if(ret>0)
+        {
+            STAT_BRANCH(BRANCH_PLAN_WIN);
+            return ret;
+        }
+    }
 
     // Try to go back start point
-    if(status.treasure)
+    if(agent->status.treasure)
     {
-        if(accessable[START_POINT][START_POINT])
+        if(reachable(agent, START_POINT, START_POINT))
         {
-            ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, START_POINT, START_POINT, steps);
+            ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, START_POINT, START_POINT, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+            STAT_BRANCH(BRANCH_GO_HOME);
             return ret;              
         }
     }
 
 
-    // Try to collect tools
-    if(tool_list!=NULL)
+    // Try to collect tools, the cheapest one first. Dynamite is only needed to blast, plan_search() picks it up on
+    // the way then, or it is collected when nothing else is left
+    if(agent->tool_list!=NULL)
     {
         //printf("delete tool\n");
-        Tool curr_tool = tool_list;
+        int distance = -1;
+        Tool curr_tool = agent->tool_list;
         while(curr_tool!=NULL)
         {
-            if(accessable[curr_tool->y][curr_tool->x])
+            int cost = curr_tool->type!='d' ? field_cost(agent, curr_tool->x, curr_tool->y) : -1;
+            if(cost!=-1 && (distance==-1 || cost<distance))
             {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_tool->x, curr_tool->y, steps);
-                return ret;
+                near.x = curr_tool->x;
+                near.y = curr_tool->y;
+                distance = cost;
             }
             curr_tool = curr_tool->next;
         }
+        if(distance!=-1)
+        {
+            ret = field_path(agent, near.x, near.y, plan);
+            STAT_BRANCH(BRANCH_TOOL);
+            return ret;
+        }
     }
 
 
     // Try to open door
-    if(status.key && (map[status.pos.y-1][status.pos.x]=='-' || map[status.pos.y][status.pos.x+1]=='-'
-            || map[status.pos.y+1][status.pos.x]=='-' || map[status.pos.y][status.pos.x-1]=='-'))
+    if(agent->status.key && (cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='-' || cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='-'
+            || cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='-' || cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='-'))
     {
         //printf("open door\n");
-        ret = open_door(steps);
+        ret = open_door(agent, plan);
+        STAT_BRANCH(BRANCH_OPEN_DOOR);
         return ret;
     }
 
 
-    // Try to go to door
-    if(status.key && door_list!=NULL)
+    // Try to go to door, the cheapest side of all doors
+    if(agent->status.key && agent->door_list!=NULL)
     {
         //printf("go to door\n");
-        Door curr_door = door_list;
+        int distance = -1;
+        Door curr_door = agent->door_list;
         while(curr_door!=NULL)
         {
-            if(accessable[curr_door->y-1][curr_door->x])
-            {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_door->x, curr_door->y-1, steps);
-                return ret;                
-            }
-            if(accessable[curr_door->y][curr_door->x+1])
-            {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_door->x+1, curr_door->y, steps);
-                return ret;                
-            }
-            if(accessable[curr_door->y+1][curr_door->x])
-            {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_door->x, curr_door->y+1, steps);
-                return ret;                
-            }
-            if(accessable[curr_door->y][curr_door->x-1])
+            struct point side;
+            int cost = field_nearest_neighbor(agent, curr_door->x, curr_door->y, &side);
+            if(cost!=-1 && (distance==-1 || cost<distance))
             {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_door->x-1, curr_door->y, steps);
-                return ret;                
+                near = side;
+                distance = cost;
             }
             curr_door = curr_door->next;
         }
+        if(distance!=-1)
+        {
+            ret = field_path(agent, near.x, near.y, plan);
+            STAT_BRANCH(BRANCH_GO_DOOR);
+            return ret;
+        }
     }
 
 
     //printf("explore\n");
-    // Just to find if every points accessable
-    int nearX = 0;
-    int nearY = 0;
-    int distance = 100000;
-    for(i=0; i<MAP_SIZE; ++i)
+    // Go to the cheapest point on the frontier, the top-left one if same cost
+    int distance = -1;
+    for(i=0; i<agent->frontier_num; ++i)
     {
-        for(j=0; j<MAP_SIZE; ++j)
+        int cost = field_cell_cost(agent, cell_of(agent, agent->frontier[i]));
+        if(cost==-1 || (distance!=-1 && cost>distance)) continue;
+        int x = cell_x(agent, agent->frontier[i]);
+        int y = cell_y(agent, agent->frontier[i]);
+        if(distance==-1 || cost<distance || y<near.y || (y==near.y && x<near.x))
         {
-            if(accessable[i][j] && seen[i][j] && !been[i][j] && heuristic(status.pos.x, status.pos.y, j, i)<distance)
-            {
-                nearX = j;
-                nearY = i;
-                distance = heuristic(status.pos.x, status.pos.y, j, i);
-            }
+            near.x = x;
+            near.y = y;
+            distance = cost;
         }
     }
 
-    if(distance!=100000) 
+    if(distance!=-1) 
     {
-        ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, nearX, nearY, steps);
+        ret = field_path(agent, near.x, near.y, plan);
+        STAT_BRANCH(BRANCH_EXPLORE);
         return ret;  
     }
 
 
     // Try to chop tree
-    if(status.axe && (map[status.pos.y-1][status.pos.x]=='T' || map[status.pos.y][status.pos.x+1]=='T'
-            || map[status.pos.y+1][status.pos.x]=='T' || map[status.pos.y][status.pos.x-1]=='T'))
+    if(agent->status.axe && (cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='T' || cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='T'
+            || cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='T' || cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='T'))
     {
         //printf("chop tree\n");
-        ret = chop_tree(steps);
+        ret = chop_tree(agent, plan);
+        STAT_BRANCH(BRANCH_CHOP_TREE);
         return ret;
     }
 
 
     // Try to go to tree
-    if(map[status.pos.y][status.pos.x]!='~' && status.axe && tree_list!=NULL)
+    if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map!='~' && agent->status.axe && agent->tree_list!=NULL)
     {
         //printf("go to tree\n");
-        Tree curr_tree = tree_list;
+        int distance = -1;
+        Tree curr_tree = agent->tree_list;
         while(curr_tree!=NULL)
         {
-            if(accessable[curr_tree->y-1][curr_tree->x])
-            {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_tree->x, curr_tree->y-1, steps);
-                return ret;                
-            }
-            if(accessable[curr_tree->y][curr_tree->x+1])
-            {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_tree->x+1, curr_tree->y, steps);
-                return ret;                
-            }
-            if(accessable[curr_tree->y+1][curr_tree->x])
-            {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_tree->x, curr_tree->y+1, steps);
-                return ret;                
-            }
-            if(accessable[curr_tree->y][curr_tree->x-1])
+            struct point side;
+            int cost = field_nearest_neighbor(agent, curr_tree->x, curr_tree->y, &side);
+            if(cost!=-1 && (distance==-1 || cost<distance))
             {
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, curr_tree->x-1, curr_tree->y, steps);
-                return ret;                
+                near = side;
+                distance = cost;
             }
             curr_tree = curr_tree->next;
         }
+        if(distance!=-1)
+        {
+            ret = field_path(agent, near.x, near.y, plan);
+            STAT_BRANCH(BRANCH_GO_TREE);
+            return ret;
+        }
     }
 
 
     // If hanging around on the sea
-    if(map[status.pos.y][status.pos.x]=='~')
+    if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map=='~')
     {
+        struct point landing;
         // Still have tree not choped yet
-        if(tree_list!=NULL)
+        Tree curr_tree = agent->tree_list;
+        while(curr_tree!=NULL)
         {
-            Tree curr=tree_list;
-            while(curr!=NULL)
+            if(find_landing(agent, curr_tree->x, curr_tree->y, &landing))
             {
-                is_accessable(status.pos.x, status.pos.y, 0, 0, true);
-                is_accessable_2(curr->x, curr->y, 0, 0, false);
-                for(i=0; i<MAP_SIZE; ++i)
-                {
-                    for(j=0; j<MAP_SIZE; ++j)
-                    {
-                        if(accessable[i][j] && accessable_2[i][j])
-                        {
-                            is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                            accessable[i][j] = true;
-                            ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, j, i, steps);
-                            return ret;                         
-                        }
-                    }
-                }
-                curr = curr->next;
-            }            
+                ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, landing.x, landing.y, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+                STAT_BRANCH(BRANCH_LAND_FOR_TREE);
+                return ret;
+            }
+            curr_tree = curr_tree->next;
         }
         // Already got reasure
-        if(status.treasure)
+        if(agent->status.treasure && find_landing(agent, START_POINT, START_POINT, &landing))
         {
-            is_accessable(status.pos.x, status.pos.y, 0, 0, true);
-            is_accessable_2(START_POINT, START_POINT, 0, 0, false);
-            for(i=0; i<MAP_SIZE; ++i)
-            {
-                for(j=0; j<MAP_SIZE; ++j)
-                {
-                    if(accessable[i][j] && accessable_2[i][j])
-                    {
-                        is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                        accessable[i][j] = true;
-                        ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, j, i, steps);
-                        return ret;                         
-                    }
-                }
-            }  
+            ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, landing.x, landing.y, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+            STAT_BRANCH(BRANCH_LAND_FOR_HOME);
+            return ret;
         }
-        if(status.key && door_list!=NULL)
+        if(agent->status.key && agent->door_list!=NULL && find_landing(agent, agent->door_list->x, agent->door_list->y, &landing))
         {
-            Door curr = door_list;
-            is_accessable(status.pos.x, status.pos.y, 0, 0, true);
-            is_accessable_2(curr->x, curr->y, 0, 0, false);
-            for(i=0; i<MAP_SIZE; ++i)
-            {
-                for(j=0; j<MAP_SIZE; ++j)
-                {
-                    if(accessable[i][j] && accessable_2[i][j])
-                    {
-                        is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                        accessable[i][j] = true;
-                        ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, j, i, steps);
-                        return ret;                         
-                    }
-                }
-            }  
+            ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, landing.x, landing.y, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+            STAT_BRANCH(BRANCH_LAND_FOR_DOOR);
+            return ret;
         }
     }
     // else hang around on the land or stepping stone
     else
     {
-        is_accessable(status.pos.x, status.pos.y, 0, 0, true);
         // Pass a lake by stepping stones
-        if(status.num_stone>0)
+        if(agent->status.num_stone>0)
         {
-            is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-            int stone_used=1;
-            while(stone_used<=status.num_stone)
+            if(stone_target(agent, 'o', &near))
             {
-                for(i=status.a.y; i<=status.b.y; ++i)
-                {
-                    for(j=status.a.x; j<=status.b.x; ++j)
-                    {
-                        //is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-
-                        if(been[i][j] && map[i][j]==' ' && accessable[i][j])
-                        {
-                            if(map[i-1][j]!='~' && map[i+1][j]!='~' && map[i][j-1]!='~' && map[i][j+1]!='~')
-                                continue;
-                            if(i-stone_used-1<0 || i+stone_used+1>=MAP_SIZE
-                                || j-stone_used-1<0 || j+stone_used+1>=MAP_SIZE)
-                            {
-                                continue;
-                            }
-                            for(m=i-stone_used-1; m<=i+stone_used+1; ++m)
-                            {
-                                for(n=j-stone_used-1; n<=j+stone_used+1; ++n)
-                                {
-                                    //is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                                    if(heuristic(j, i, n, m)!=stone_used+1)
-                                        continue;
-                                    if(map[m][n]=='o' && is_accessable_lake(j,i,n,m))
-                                    {
-                                        //is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                                        ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, j, i, steps);
-                                        go_on_lake=true;
-                                        stoneX=n;
-                                        stoneY=m;
-                                        return ret;
-                                    }                                                 
-                                }
-                            }
-                        }
-                    }
-                }                
-                stone_used++;
+                ret = stone_go(agent, near.x, near.y, plan);
+                STAT_BRANCH(BRANCH_STONE_LAKE);
+                return ret;
             }
         }
         
-        else
+        // Only go on the sea with a raft, or the agent drowns
+        else if(agent->status.raft)
         {
-            is_accessable(status.pos.x, status.pos.y, 0, 0, true);
+            int land = region_find(agent, agent->status.pos.x, agent->status.pos.y);
             // Considering using raft to pass lake
-            if(status.been_to_sea && !status.treasure)
+            if(agent->status.been_to_sea && !agent->status.treasure)
             {
                 int lakeX = 0;
                 int lakeY = 0;
                 int landNeighbor = 0;
                 int count=0;
-                for(i=0; i<MAP_SIZE; ++i)
+                for(i=agent->status.a.y; i<=agent->status.b.y; ++i)
                 {
-                    for(j=0; j<MAP_SIZE; ++j)
+                    for(j=agent->status.a.x; j<=agent->status.b.x; ++j)
                     {
-                        if(map[i][j]=='~' && accessable[i][j])
+                        if(cell_peek(agent, j, i)->map=='~' && next_to_region(agent, j, i, land))
                         {
                             count=0;
-                            if(map[i-1][j]==' ') count++;
-                            if(map[i+1][j]==' ') count++;
-                            if(map[i][j-1]==' ') count++;
-                            if(map[i][j+1]==' ') count++;
+                            if(cell_peek(agent, j, i-1)->map==' ') count++;
+                            if(cell_peek(agent, j, i+1)->map==' ') count++;
+                            if(cell_peek(agent, j-1, i)->map==' ') count++;
+                            if(cell_peek(agent, j+1, i)->map==' ') count++;
                             if(count>landNeighbor)
                             {
                                 lakeX = j;
@@ -1132,69 +1930,35 @@ int find_a_path( char* steps )
                 }
                 if(landNeighbor!=0) 
                 {
-                    is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                    accessable[lakeY][lakeX]=true;
-                    ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, lakeX, lakeY, steps);
+                    ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, lakeX, lakeY, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+                    STAT_BRANCH(BRANCH_RAFT_LAKE);
                     return ret;  
                 }                
             }
-            if(tree_list!=NULL)
+            // Go to the sea which can take us to the land of the tree
+            struct point sea;
+            if(agent->tree_list!=NULL && find_crossing(agent, agent->tree_list->x, agent->tree_list->y, &sea))
             {
-                int seaX = 0;
-                int seaY = 0;
-                int landNeighbor = 4;
-                int count=0;
-                for(i=0; i<MAP_SIZE; ++i)
-                {
-                    for(j=0; j<MAP_SIZE; ++j)
-                    {
-                        if(map[i][j]=='~')
-                        {
-                            count=0;
-                            if(map[i-1][j]!='~') count++;
-                            if(map[i+1][j]!='~') count++;
-                            if(map[i][j-1]!='~') count++;
-                            if(map[i][j+1]!='~') count++;
-                            is_accessable(status.pos.x, status.pos.y, 0, 0, true);
-                            is_accessable_2(tree_list->x, tree_list->y, 0, 0, true);
-                            if(accessable[j][i] && accessable_2[j][i])
-                            {
-                                seaX = j;
-                                seaY = i;
-                                landNeighbor=1;
-                                is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                                accessable[seaY][seaX]=true;
-                                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, seaX, seaY, steps);
-                                status.been_to_sea = true;
-                                return ret;  
-                            }
-                        }
-                    }
-                }
-                if(landNeighbor!=4) 
-                {
-                    is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                    accessable[seaY][seaX]=true;
-                    ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, seaX, seaY, steps);
-                    status.been_to_sea = true;
-                    return ret;  
-                }                   
+                ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, sea.x, sea.y, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+                agent->status.been_to_sea = true;
+                STAT_BRANCH(BRANCH_SEA_CROSSING);
+                return ret;
             }
             int seaX = 0;
             int seaY = 0;
             int landNeighbor = 4;
             int count=0;
-            for(i=0; i<MAP_SIZE; ++i)
+            for(i=agent->status.a.y; i<=agent->status.b.y; ++i)
             {
-                for(j=0; j<MAP_SIZE; ++j)
+                for(j=agent->status.a.x; j<=agent->status.b.x; ++j)
                 {
-                    if(map[i][j]=='~' && accessable[i][j])
+                    if(cell_peek(agent, j, i)->map=='~' && next_to_region(agent, j, i, land))
                     {
                         count=0;
-                        if(map[i-1][j]!='~') count++;
-                        if(map[i+1][j]!='~') count++;
-                        if(map[i][j-1]!='~') count++;
-                        if(map[i][j+1]!='~') count++;
+                        if(cell_peek(agent, j, i-1)->map!='~') count++;
+                        if(cell_peek(agent, j, i+1)->map!='~') count++;
+                        if(cell_peek(agent, j-1, i)->map!='~') count++;
+                        if(cell_peek(agent, j+1, i)->map!='~') count++;
                         if(count<landNeighbor)
                         {
                             seaX = j;
@@ -1206,81 +1970,41 @@ int find_a_path( char* steps )
             }
             if(landNeighbor!=4) 
             {
-                is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                accessable[seaY][seaX]=true;
-                ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, seaX, seaY, steps);
-                status.been_to_sea = true;
+                ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, seaX, seaY, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+                agent->status.been_to_sea = true;
+                STAT_BRANCH(BRANCH_GO_SEA);
                 return ret;  
             }            
         }        
     }
 
-    if(map[status.pos.y][status.pos.x]!='~' && status.treasure==false)
+    if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map!='~' && agent->status.treasure==false)
     {
-        if(status.num_stone>0)
+        if(agent->status.num_stone>0 && stone_target(agent, '$', &near))
         {
-            is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-            int stone_used=1;
-            while(stone_used<=status.num_stone)
-            {
-                for(i=status.a.y; i<=status.b.y; ++i)
-                {
-                    for(j=status.a.x; j<=status.b.x; ++j)
-                    {
-                        //is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-
-                        if(been[i][j] && (map[i][j]==' '|| map[i][j]=='O')&& accessable[i][j])
-                        {
-                            if(map[i-1][j]!='~' && map[i+1][j]!='~' && map[i][j-1]!='~' && map[i][j+1]!='~')
-                                continue;
-                            if(i-stone_used-1<0 || i+stone_used+1>=MAP_SIZE
-                                || j-stone_used-1<0 || j+stone_used+1>=MAP_SIZE)
-                            {
-                                continue;
-                            }
-                            for(m=i-stone_used-1; m<=i+stone_used+1; ++m)
-                            {
-                                for(n=j-stone_used-1; n<=j+stone_used+1; ++n)
-                                {
-                                    //is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                                    if(heuristic(j, i, n, m)!=stone_used+1)
-                                        continue;
-                                    if(map[m][n]=='$' && is_accessable_lake(j,i,n,m))
-                                    {
-                                        //is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-                                        ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, j, i, steps);
-                                        go_on_lake=true;
-                                        stoneX=n;
-                                        stoneY=m;
-                                        return ret;
-                                    }                                                 
-                                }
-                            }
-                        }
-                    }
-                }                
-                stone_used++;
-            }            
+            ret = stone_go(agent, near.x, near.y, plan);
+            STAT_BRANCH(BRANCH_STONE_TREASURE);
+            return ret;
         }
     }
-    if(map[status.pos.y][status.pos.x]!='~' && status.num_stone>0)
+    if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map!='~' && agent->status.num_stone>0)
     {
-        is_accessable(status.pos.x, status.pos.y, 0, 0, true);
+        int land = region_find(agent, agent->status.pos.x, agent->status.pos.y);
         int lakeX = 0;
         int lakeY = 0;
         int landNeighbor = 0;
         int count=0;
-        for(i=0; i<MAP_SIZE; ++i)
+        for(i=agent->status.a.y; i<=agent->status.b.y; ++i)
         {
-            for(j=0; j<MAP_SIZE; ++j)
+            for(j=agent->status.a.x; j<=agent->status.b.x; ++j)
             {
-                if(map[i][j]=='~' && accessable[i][j])
+                if(cell_peek(agent, j, i)->map=='~' && next_to_region(agent, j, i, land))
                 {
                     count=0;
-                    if(map[i-1][j]==' ') count++;
-                    if(map[i+1][j]==' ') count++;
-                    if(map[i][j-1]==' ') count++;
-                    if(map[i][j+1]==' ') count++;
+                    if(cell_peek(agent, j, i-1)->map==' ') count++;
+                    if(cell_peek(agent, j, i+1)->map==' ') count++;
+                    if(cell_peek(agent, j-1, i)->map==' ') count++;
+                    if(cell_peek(agent, j+1, i)->map==' ') count++;
                     if(count>landNeighbor)
                     {
                         lakeX = j;
@@ -1292,295 +2016,467 @@ int find_a_path( char* steps )
         }
         if(landNeighbor!=0) 
         {
-            is_accessable(status.pos.x, status.pos.y, 0, 0, false);
-            accessable[lakeY][lakeX]=true;
-            ret = get_path_a_star(status.pos.x, status.pos.y, status.direction, lakeX, lakeY, steps);
+            ret = get_path_a_star(agent, agent->status.pos.x, agent->status.pos.y, agent->status.direction, lakeX, lakeY, agent_passable(agent), ASTAR_FORWARD, agent->astar_heuristic, plan);
+            STAT_BRANCH(BRANCH_STONE_ANY_LAKE);
             return ret;  
         }
     }
 
-    return 0;  
-}
-
-bool is_accessable(int srcX, int srcY, int destX, int destY, bool transfer)
-{
-    int i,j;
-    for (i = 0; i < MAP_SIZE; ++i)
+    // Collect the dynamite left, the cheapest first, so there is more to blast with
+    distance = -1;
+    for(Tool curr_tool=agent->tool_list; curr_tool!=NULL; curr_tool=curr_tool->next)
     {
-        for(j=0; j < MAP_SIZE; ++j)
+        int cost = curr_tool->type=='d' ? field_cost(agent, curr_tool->x, curr_tool->y) : -1;
+        if(cost!=-1 && (distance==-1 || cost<distance))
         {
-            accessable[i][j]=false;
+            near.x = curr_tool->x;
+            near.y = curr_tool->y;
+            distance = cost;
         }
     }
+    if(distance!=-1)
+    {
+        ret = field_path(agent, near.x, near.y, plan);
+        STAT_BRANCH(BRANCH_DYNAMITE);
+        return ret;
+    }
 
-    if(map[srcY][srcX]=='~')
+    // Stuck by every branch, the frontier may still be got to with the tools on the way
+    ret = plan_search(agent, PLAN_EXPLORE, plan);
+    if(ret>0)
     {
-        accessable[srcY][srcX] = true;
-        recursive_mark_access(srcX, srcY, '~');
-        if(transfer)
-        {
-            for(i=0; i<MAP_SIZE; ++i)
-            {
-                for(j=0; j<MAP_SIZE; ++j)
-                {
-                    if(map[i][j]!='*' && map[i][j]!='~' && map[i][j]!='T'
-                        && (   (map[i-1][j]=='~' && accessable[i-1][j]) 
-                            || (map[i+1][j]=='~' && accessable[i+1][j]) 
-                            || (map[i][j-1]=='~' && accessable[i][j-1]) 
-                            || (map[i][j+1]=='~' && accessable[i][j+1]) ) )
-                    {
-                        accessable[i][j]=true;
-                    }
-                }
-            }
-        }  
+        STAT_BRANCH(BRANCH_PLAN_EXPLORE);
+        return ret;
     }
-    else
-    {        
-        accessable[srcY][srcX] = true;
-        recursive_mark_access(srcX, srcY, ' ');
-        if(transfer)
-        {
-            for(i=0; i<MAP_SIZE; ++i)
-            {
-                for(j=0; j<MAP_SIZE; ++j)
-                {
-                    if(map[i][j]=='~' 
-                        && (   (map[i-1][j]!='~' && accessable[i-1][j]) 
-                            || (map[i+1][j]!='~' && accessable[i+1][j]) 
-                            || (map[i][j-1]!='~' && accessable[i][j-1]) 
-                            || (map[i][j+1]!='~' && accessable[i][j+1]) ) )
-                    {
-                        accessable[i][j]=true;
-                    }
-                }
-            }
-        }  
+
+    STAT_BRANCH(BRANCH_NONE);
+    return 0;  
+}
+
+// Mark accessable every point reachable from src, and return whether dest is one of them
+bool is_accessable(Agent agent, int srcX, int srcY, int destX, int destY, bool transfer)
+{
+    // On the sea can only sail on the sea, on the land only walk on the land
+    if(cell_peek(agent, srcX, srcY)->map=='~')
+    {
+        flood_fill(agent, srcX, srcY, passable_sea, transfer ? transfer_to_land : NULL);
+    }
+    else
+    {
+        flood_fill(agent, srcX, srcY, passable_land, transfer ? transfer_to_sea : NULL);
     }
 
-    return accessable[destY][destX];
+    return accessable(agent, cell_peek(agent, destX, destY));
 }
 
-void recursive_mark_access(int x, int y, char type)
+// BFS from (x,y) over points passable, marking them accessable. If transfer is given, points next to
+// the marked ones where transfer is true are marked too, but not spread from
+void flood_fill(Agent agent, int x, int y, Passable passable, Passable transfer)
 {
-    if(type=='~')
+    int head = 0;
+    int tail = 0;
+    int k;
+    STAT_TIMER_START(cycles);
+    STAT_ADD(flood_fills, 1);
+
+    // Every point goes in the queue at most once, which holds every point allocated
+    agent->flood_id++;
+    cell_at(agent, x, y)->accessable = agent->flood_id;
+    agent->flood_queue[tail++] = cell_id(agent, x, y);
+
+    while(head!=tail)
     {
-        if(seen[y-1][x] && map[y-1][x]=='~' && accessable[y-1][x] == false)
-        {
-            accessable[y-1][x] = true;
-            recursive_mark_access(x, y-1, type);
-        }
+        x = cell_x(agent, agent->flood_queue[head]);
+        y = cell_y(agent, agent->flood_queue[head]);
+        head++;
 
-        if(seen[y+1][x] && map[y+1][x]=='~' && accessable[y+1][x] == false)
+        for(k=0; k<4; ++k)
         {
-            accessable[y+1][x] = true;
-            recursive_mark_access(x, y+1, type);
+            int nx = x+dir_dx[k];
+            int ny = y+dir_dy[k];
+            // Points next to a known one are always allocated
+            struct cell* next = cell_find(agent, nx, ny);
+            if(next==NULL || next->accessable==agent->flood_id) continue;
+            if(passable(agent, nx, ny))
+            {
+                next->accessable = agent->flood_id;
+                agent->flood_queue[tail++] = cell_id(agent, nx, ny);
+                assert(tail<=agent->cells_cap);
+            }
+            else if(transfer!=NULL && transfer(agent, nx, ny))
+            {
+                next->accessable = agent->flood_id;
+            }
         }
+    }
+    STAT_ADD(flood_cells, tail);
+    STAT_TIMER_STOP(flood_cycles, cycles);
+}
+
+bool accessable(Agent agent, const struct cell* cell)
+{
+    return cell->accessable==agent->flood_id;
+}
+
+// Can walk on it
+bool passable_land(Agent agent, int x, int y)
+{
+    const struct cell* cell = cell_peek(agent, x, y);
+    return (cell->seen || cell->been) && cell->map!='~' && cell->map!='*' && cell->map!='T' && cell->map!='-';
+}
+
+// Can sail on it
+bool passable_sea(Agent agent, int x, int y)
+{
+    const struct cell* cell = cell_peek(agent, x, y);
+    return cell->seen && cell->map=='~';
+}
+
+// Can get on the sea from the land here
+bool transfer_to_sea(Agent agent, int x, int y)
+{
+    return cell_peek(agent, x, y)->map=='~';
+}
+
+// Can get on the land from the sea here
+bool transfer_to_land(Agent agent, int x, int y)
+{
+    char map = cell_peek(agent, x, y)->map;
+    return map!='*' && map!='~' && map!='T';
+}
+
+// Which region a point can be in, land and sea are never joined
+char region_kind_of(Agent agent, int x, int y)
+{
+    if(passable_land(agent, x, y)) return REGION_LAND;
+    if(passable_sea(agent, x, y)) return REGION_SEA;
+    return REGION_NONE;
+}
+
+// Call after map[y][x], seen[y][x] or been[y][x] changed
+void region_update(Agent agent, int x, int y)
+{
+    char kind = region_kind_of(agent, x, y);
+    if(kind==cell_peek(agent, x, y)->region_kind) return;
+    agent->region_graph_stale = true;
+
+    // A point left its region, union-find can not split it, so build again when needed
+    if(cell_peek(agent, x, y)->region_kind!=REGION_NONE)
+    {
+        cell_at(agent, x, y)->region_kind = kind;
+        agent->region_dirty = true;
+        return;
+    }
+
+    cell_at(agent, x, y)->region_kind = kind;
+    if(!agent->region_dirty) region_add(agent, x, y);
+}
 
-        if(seen[y][x-1] && map[y][x-1]=='~' && accessable[y][x-1] == false)
+// Make (x,y) a region of its own and join it with the neighbors of the same kind
+void region_add(Agent agent, int x, int y)
+{
+    int k;
+    cell_at(agent, x, y)->region_parent = cell_id(agent, x, y);
+    cell_at(agent, x, y)->region_size = 1;
+    for(k=0; k<4; ++k)
+    {
+        int nx = x+dir_dx[k];
+        int ny = y+dir_dy[k];
+        // Neighbor not added yet when rebuilding
+        if(cell_peek(agent, nx, ny)->region_parent==-1) continue;
+        if(cell_peek(agent, nx, ny)->region_kind==cell_peek(agent, x, y)->region_kind)
         {
-            accessable[y][x-1] = true;
-            recursive_mark_access(x-1, y, type);
+            region_union(agent, cell_id(agent, x, y), cell_id(agent, nx, ny));
         }
+    }
+}
+
+// Root of the region of point index p, halving the path on the way
+int region_root(Agent agent, int p)
+{
+    struct cell* cell = cell_of(agent, p);
+    while(cell->region_parent!=p)
+    {
+        struct cell* parent = cell_of(agent, cell->region_parent);
+        cell->region_parent = parent->region_parent;
+        p = cell->region_parent;
+        cell = cell_of(agent, p);
+    }
+    return p;
+}
+
+void region_union(Agent agent, int p, int q)
+{
+    p = region_root(agent, p);
+    q = region_root(agent, q);
+    if(p==q) return;
+    if(cell_of(agent, p)->region_size<cell_of(agent, q)->region_size)
+    {
+        int temp = p;
+        p = q;
+        q = temp;
+    }
+    cell_of(agent, q)->region_parent = p;
+    cell_of(agent, p)->region_size += cell_of(agent, q)->region_size;
+}
 
-        if(seen[y][x+1] && map[y][x+1]=='~' && accessable[y][x+1] == false)
+// Build all regions of the known map again
+void region_rebuild(Agent agent)
+{
+    int c,k;
+    STAT_ADD(region_rebuilds, 1);
+    for(c=0; c<agent->chunks_num; ++c)
+    {
+        for(k=0; k<CHUNK_CELLS; ++k)
         {
-            accessable[y][x+1] = true;
-            recursive_mark_access(x+1, y, type);
+            agent->chunks[c]->cells[k].region_parent = -1;
         }
     }
-    else
+    agent->region_dirty = false;
+    for(c=0; c<agent->chunks_num; ++c)
     {
-        if(seen[y-1][x] && map[y-1][x]!='~' && map[y-1][x]!='*' && map[y-1][x]!='T' && map[y-1][x]!='-' && accessable[y-1][x] == false)
+        Chunk chunk = agent->chunks[c];
+        for(k=0; k<CHUNK_CELLS; ++k)
         {
-            accessable[y-1][x] = true;
-            recursive_mark_access(x, y-1, type);
+            if(chunk->cells[k].region_kind!=REGION_NONE)
+            {
+                region_add(agent, chunk->x+(k&CHUNK_MASK), chunk->y+(k>>CHUNK_SHIFT));
+            }
         }
+    }
+}
 
-        if(seen[y+1][x] && map[y+1][x]!='~' && map[y+1][x]!='*' && map[y+1][x]!='T' && map[y+1][x]!='-' && accessable[y+1][x] == false)
-        {
-            accessable[y+1][x] = true;
-            recursive_mark_access(x, y+1, type);
-        }
+// Label of the region (x,y) is in, -1 if can not stand there
+int region_find(Agent agent, int x, int y)
+{
+    if(agent->region_dirty) region_rebuild(agent);
+    if(cell_peek(agent, x, y)->region_kind==REGION_NONE) return -1;
+    return region_root(agent, cell_id(agent, x, y));
+}
 
-        if(seen[y][x-1] && map[y][x-1]!='~' && map[y][x-1]!='*' && map[y][x-1]!='T' && map[y][x-1]!='-' && accessable[y][x-1] == false)
-        {
-            accessable[y][x-1] = true;
-            recursive_mark_access(x-1, y, type);
-        }
+// Can agent get to (x,y) without a transfer between land and sea
+bool reachable(Agent agent, int x, int y)
+{
+    int label = region_find(agent, x, y);
+    STAT_ADD(reachable_calls, 1);
+    return label!=-1 && label==region_find(agent, agent->status.pos.x, agent->status.pos.y);
+}
 
-        if(seen[y][x+1] && map[y][x+1]!='~' && map[y][x+1]!='*' && map[y][x+1]!='T' && map[y][x+1]!='-' && accessable[y][x+1] == false)
-        {
-            accessable[y][x+1] = true;
-            recursive_mark_access(x+1, y, type);
-        }
+// Whether (x,y) is next to a point in region label
+bool next_to_region(Agent agent, int x, int y, int label)
+{
+    int k;
+    for(k=0; k<4; ++k)
+    {
+        if(region_find(agent, x+dir_dx[k], y+dir_dy[k])==label) return true;
     }
+    return false;
 }
 
-bool is_accessable_2(int srcX, int srcY, int destX, int destY, bool transfer)
+// Find every pair of land and sea regions next to each other, and the first land point (in row order) between them
+void region_graph_build(Agent agent)
 {
-    int i,j;
-    for (i = 0; i < MAP_SIZE; ++i)
+    int i,j,k,e;
+
+    if(agent->region_dirty) region_rebuild(agent);
+
+    // Forget the edges of last time
+    for(e=0; e<agent->region_edges_num; ++e)
     {
-        for(j=0; j < MAP_SIZE; ++j)
-        {
-            accessable_2[i][j]=false;
-        }
+        cell_of(agent, agent->region_edges[e].land)->region_edge_head = -1;
     }
+    agent->region_edges_num = 0;
+    agent->region_graph_stale = false;
 
-    if(map[srcY][srcX]=='~')
+    for(i=agent->status.a.y; i<=agent->status.b.y; ++i)
     {
-        accessable_2[srcY][srcX] = true;
-        recursive_mark_access_2(srcX, srcY, '~');
-        if(transfer)
+        for(j=agent->status.a.x; j<=agent->status.b.x; ++j)
         {
-            for(i=0; i<MAP_SIZE; ++i)
+            struct cell* cell = cell_find(agent, j, i);
+            // Nothing seen in this chunk, go on to the next one
+            if(cell==NULL)
             {
-                for(j=0; j<MAP_SIZE; ++j)
-                {
-                    if(map[i][j]!='*' && map[i][j]!='~' && map[i][j]!='T'
-                        && (   (map[i-1][j]=='~' && accessable_2[i-1][j]) 
-                            || (map[i+1][j]=='~' && accessable_2[i+1][j]) 
-                            || (map[i][j-1]=='~' && accessable_2[i][j-1]) 
-                            || (map[i][j+1]=='~' && accessable_2[i][j+1]) ) )
-                    {
-                        accessable_2[i][j]=true;
-                    }
-                }
+                j |= CHUNK_MASK;
+                continue;
             }
-        }  
-    }
-    else
-    {        
-        accessable_2[srcY][srcX] = true;
-        recursive_mark_access_2(srcX, srcY, ' ');
-        if(transfer)
-        {
-            for(i=0; i<MAP_SIZE; ++i)
+            if(cell->region_kind!=REGION_LAND) continue;
+            int land = region_root(agent, cell_id(agent, j, i));
+            for(k=0; k<4; ++k)
             {
-                for(j=0; j<MAP_SIZE; ++j)
+                int nx = j+dir_dx[k];
+                int ny = i+dir_dy[k];
+                if(cell_peek(agent, nx, ny)->region_kind!=REGION_SEA) continue;
+                int sea = region_root(agent, cell_id(agent, nx, ny));
+                if(region_landing(agent, land, sea, NULL)) continue;
+
+                if(agent->region_edges_num==agent->region_edges_cap)
                 {
-                    if(map[i][j]=='~' 
-                        && (   (map[i-1][j]!='~' && accessable_2[i-1][j]) 
-                            || (map[i+1][j]!='~' && accessable_2[i+1][j]) 
-                            || (map[i][j-1]!='~' && accessable_2[i][j-1]) 
-                            || (map[i][j+1]!='~' && accessable_2[i][j+1]) ) )
-                    {
-                        accessable_2[i][j]=true;
-                    }
+                    agent->region_edges_cap = MAX(2*agent->region_edges_cap, 64);
+                    agent->region_edges = realloc(agent->region_edges, agent->region_edges_cap*sizeof(struct regionEdge));
+                    assert(agent->region_edges!=NULL);
                 }
+                struct regionEdge* edge = &agent->region_edges[agent->region_edges_num];
+                edge->land = land;
+                edge->sea = sea;
+                edge->x = j;
+                edge->y = i;
+                edge->seaX = nx;
+                edge->seaY = ny;
+                edge->next = cell_of(agent, land)->region_edge_head;
+                cell_of(agent, land)->region_edge_head = agent->region_edges_num;
+                agent->region_edges_num++;
             }
-        }  
+        }
     }
-
-    return accessable_2[destY][destX];
 }
 
-void recursive_mark_access_2(int x, int y, char type)
+// Whether land region and sea region are next to each other, and if so the first land point between them
+bool region_landing(Agent agent, int land, int sea, struct point* at)
 {
-    if(type=='~')
+    int e;
+    if(agent->region_graph_stale) region_graph_build(agent);
+    for(e=cell_of(agent, land)->region_edge_head; e!=-1; e=agent->region_edges[e].next)
     {
-        if(seen[y-1][x] && map[y-1][x]=='~' && accessable_2[y-1][x] == false)
+        if(agent->region_edges[e].sea==sea)
         {
-            accessable_2[y-1][x] = true;
-            recursive_mark_access_2(x, y-1, type);
-        }
-
-        if(seen[y+1][x] && map[y+1][x]=='~' && accessable_2[y+1][x] == false)
-        {
-            accessable_2[y+1][x] = true;
-            recursive_mark_access_2(x, y+1, type);
+            if(at!=NULL)
+            {
+                at->x = agent->region_edges[e].x;
+                at->y = agent->region_edges[e].y;
+            }
+            return true;
         }
+    }
+    return false;
+}
 
-        if(seen[y][x-1] && map[y][x-1]=='~' && accessable_2[y][x-1] == false)
-        {
-            accessable_2[y][x-1] = true;
-            recursive_mark_access_2(x-1, y, type);
-        }
+// Land point where agent on sea can land, to get to the land regions around (x,y). (x,y) can be a door or
+// tree, then every land next to it counts. Return false if there is none
+bool find_landing(Agent agent, int x, int y, struct point* at)
+{
+    int sea = region_find(agent, agent->status.pos.x, agent->status.pos.y);
+    int k;
+    bool found = false;
 
-        if(seen[y][x+1] && map[y][x+1]=='~' && accessable_2[y][x+1] == false)
-        {
-            accessable_2[y][x+1] = true;
-            recursive_mark_access_2(x+1, y, type);
-        }
-    }
-    else
+    for(k=-1; k<4; ++k)
     {
-        if(seen[y-1][x] && map[y-1][x]!='~' && map[y-1][x]!='*' && map[y-1][x]!='T' && map[y-1][x]!='-' && accessable_2[y-1][x] == false)
+        int land = (k==-1) ? region_find(agent, x, y) : region_find(agent, x+dir_dx[k], y+dir_dy[k]);
+        struct point landing;
+        if(land==-1 || cell_of(agent, land)->region_kind!=REGION_LAND) continue;
+        if(!region_landing(agent, land, sea, &landing)) continue;
+        // Take the first one in row order as before
+        if(!found || landing.y<at->y || (landing.y==at->y && landing.x<at->x))
         {
-            accessable_2[y-1][x] = true;
-            recursive_mark_access_2(x, y-1, type);
+            *at = landing;
+            found = true;
         }
+    }
+    return found;
+}
 
-        if(seen[y+1][x] && map[y+1][x]!='~' && map[y+1][x]!='*' && map[y+1][x]!='T' && map[y+1][x]!='-' && accessable_2[y+1][x] == false)
-        {
-            accessable_2[y+1][x] = true;
-            recursive_mark_access_2(x, y+1, type);
-        }
+// Sea point next to the land of agent, on a sea which also touches the land around (x,y). Return false if
+// there is none
+bool find_crossing(Agent agent, int x, int y, struct point* at)
+{
+    int land = region_find(agent, agent->status.pos.x, agent->status.pos.y);
+    int e,k;
+    bool found = false;
 
-        if(seen[y][x-1] && map[y][x-1]!='~' && map[y][x-1]!='*' && map[y][x-1]!='T' && map[y][x-1]!='-' && accessable_2[y][x-1] == false)
+    if(agent->region_graph_stale) region_graph_build(agent);
+    for(e=cell_of(agent, land)->region_edge_head; e!=-1; e=agent->region_edges[e].next)
+    {
+        for(k=-1; k<4; ++k)
         {
-            accessable_2[y][x-1] = true;
-            recursive_mark_access_2(x-1, y, type);
+            int other = (k==-1) ? region_find(agent, x, y) : region_find(agent, x+dir_dx[k], y+dir_dy[k]);
+            if(other==-1 || cell_of(agent, other)->region_kind!=REGION_LAND) continue;
+            if(!region_landing(agent, other, agent->region_edges[e].sea, NULL)) continue;
+            if(!found || agent->region_edges[e].seaY<at->y || (agent->region_edges[e].seaY==at->y && agent->region_edges[e].seaX<at->x))
+            {
+                at->x = agent->region_edges[e].seaX;
+                at->y = agent->region_edges[e].seaY;
+                found = true;
+            }
         }
+    }
+    return found;
+}
 
-        if(seen[y][x+1] && map[y][x+1]!='~' && map[y][x+1]!='*' && map[y][x+1]!='T' && map[y][x+1]!='-' && accessable_2[y][x+1] == false)
-        {
-            accessable_2[y][x+1] = true;
-            recursive_mark_access_2(x+1, y, type);
-        }
+// Keep the frontier the points seen, not been to and passable, O(1) by swapping with the last one on removal
+void frontier_update(Agent agent, int x, int y)
+{
+    bool in = cell_peek(agent, x, y)->seen && !cell_peek(agent, x, y)->been && cell_peek(agent, x, y)->region_kind!=REGION_NONE;
+    int slot = cell_peek(agent, x, y)->frontier_slot;
+    if(in && slot==0)
+    {
+        agent->frontier[agent->frontier_num] = cell_id(agent, x, y);
+        cell_at(agent, x, y)->frontier_slot = ++agent->frontier_num;
     }
+    else if(!in && slot!=0)
+    {
+        int last = agent->frontier[--agent->frontier_num];
+        agent->frontier[slot-1] = last;
+        cell_of(agent, last)->frontier_slot = slot;
+        cell_at(agent, x, y)->frontier_slot = 0;
+    }
+}
+
+// Passable function for where the agent is, the land or the sea
+Passable agent_passable(Agent agent)
+{
+    if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map=='~') return passable_sea;
+    return passable_land;
 }
 
-int open_door(char* steps)
+int open_door(Agent agent, Plan plan)
 {
-    if(status.direction==NORTH)
+    char* steps = plan_reserve(plan, 3);
+    if(agent->status.direction==NORTH)
     {
-        if(map[status.pos.y-1][status.pos.x]=='-')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='-')
         {
             steps[0] = 'u';
             return 1;
         }
-        else if(map[status.pos.y][status.pos.x+1]=='-')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='-')
         {
             steps[0] = 'r';
             steps[1] = 'u';
             return 2;
         }
-        else if(map[status.pos.y+1][status.pos.x]=='-')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='-')
         {
             steps[0] = 'r';
             steps[1] = 'r';
             steps[2] = 'u';
             return 3;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='-') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='-') 
         {
             steps[0] = 'l';
             steps[1] = 'u';
             return 2;
         }
     }
-    else if(status.direction==EAST)
+    else if(agent->status.direction==EAST)
     {
-        if(map[status.pos.y-1][status.pos.x]=='-')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='-')
         {
             steps[0] = 'l';
             steps[1] = 'u';
             return 2;
         }
-        else if(map[status.pos.y][status.pos.x+1]=='-')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='-')
         {
             steps[0] = 'u';
             return 1;
         }
-        else if(map[status.pos.y+1][status.pos.x]=='-')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='-')
         {
             steps[0] = 'r';
             steps[1] = 'u';
             return 2;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='-') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='-') 
         {
             steps[0] = 'r';
             steps[1] = 'r';
@@ -1588,55 +2484,55 @@ int open_door(char* steps)
             return 3;           
         }
     }
-    else if(status.direction==SOUTH)
+    else if(agent->status.direction==SOUTH)
     {
-        if(map[status.pos.y-1][status.pos.x]=='-')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='-')
         {
             steps[0] = 'r';
             steps[1] = 'r';
             steps[2] = 'u';
             return 3;             
         }
-        else if(map[status.pos.y][status.pos.x+1]=='-')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='-')
         {
             steps[0] = 'l';
             steps[1] = 'u';
             return 2;
         }
-        else if(map[status.pos.y+1][status.pos.x]=='-')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='-')
         {
             steps[0] = 'u';
             return 1;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='-') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='-') 
         {
             steps[0] = 'r';
             steps[1] = 'u';
             return 2;            
         }
     }
-    else if(status.direction==WEST)
+    else if(agent->status.direction==WEST)
     {
-        if(map[status.pos.y-1][status.pos.x]=='-')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='-')
         {
             steps[0] = 'r';
             steps[1] = 'u';
             return 2;             
         }
-        else if(map[status.pos.y][status.pos.x+1]=='-')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='-')
         {
             steps[0] = 'r';
             steps[1] = 'r';
             steps[2] = 'u';
             return 3; 
         }
-        else if(map[status.pos.y+1][status.pos.x]=='-')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='-')
         {
             steps[0] = 'l';
             steps[1] = 'u';
             return 2;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='-') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='-') 
         {
             steps[0] = 'u';
             return 1;            
@@ -1645,55 +2541,56 @@ int open_door(char* steps)
     return 0;
 }
 
-int chop_tree(char* steps)
+int chop_tree(Agent agent, Plan plan)
 {
-    if(status.direction==NORTH)
+    char* steps = plan_reserve(plan, 3);
+    if(agent->status.direction==NORTH)
     {
-        if(map[status.pos.y-1][status.pos.x]=='T')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='T')
         {
             steps[0] = 'c';
             return 1;
         }
-        else if(map[status.pos.y][status.pos.x+1]=='T')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='T')
         {
             steps[0] = 'r';
             steps[1] = 'c';
             return 2;
         }
-        else if(map[status.pos.y+1][status.pos.x]=='T')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='T')
         {
             steps[0] = 'r';
             steps[1] = 'r';
             steps[2] = 'c';
             return 3;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='T') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='T') 
         {
             steps[0] = 'l';
             steps[1] = 'c';
             return 2;
         }
     }
-    else if(status.direction==EAST)
+    else if(agent->status.direction==EAST)
     {
-        if(map[status.pos.y-1][status.pos.x]=='T')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='T')
         {
             steps[0] = 'l';
             steps[1] = 'c';
             return 2;
         }
-        else if(map[status.pos.y][status.pos.x+1]=='T')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='T')
         {
             steps[0] = 'c';
             return 1;
         }
-        else if(map[status.pos.y+1][status.pos.x]=='T')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='T')
         {
             steps[0] = 'r';
             steps[1] = 'c';
             return 2;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='T') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='T') 
         {
             steps[0] = 'r';
             steps[1] = 'r';
@@ -1701,55 +2598,55 @@ int chop_tree(char* steps)
             return 3;           
         }
     }
-    else if(status.direction==SOUTH)
+    else if(agent->status.direction==SOUTH)
     {
-        if(map[status.pos.y-1][status.pos.x]=='T')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='T')
         {
             steps[0] = 'r';
             steps[1] = 'r';
             steps[2] = 'c';
             return 3;             
         }
-        else if(map[status.pos.y][status.pos.x+1]=='T')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='T')
         {
             steps[0] = 'l';
             steps[1] = 'c';
             return 2;
         }
-        else if(map[status.pos.y+1][status.pos.x]=='T')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='T')
         {
             steps[0] = 'c';
             return 1;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='T') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='T') 
         {
             steps[0] = 'r';
             steps[1] = 'c';
             return 2;            
         }
     }
-    else if(status.direction==WEST)
+    else if(agent->status.direction==WEST)
     {
-        if(map[status.pos.y-1][status.pos.x]=='T')
+        if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y-1)->map=='T')
         {
             steps[0] = 'r';
             steps[1] = 'c';
             return 2;             
         }
-        else if(map[status.pos.y][status.pos.x+1]=='T')
+        else if(cell_peek(agent, agent->status.pos.x+1, agent->status.pos.y)->map=='T')
         {
             steps[0] = 'r';
             steps[1] = 'r';
             steps[2] = 'c';
             return 3; 
         }
-        else if(map[status.pos.y+1][status.pos.x]=='T')
+        else if(cell_peek(agent, agent->status.pos.x, agent->status.pos.y+1)->map=='T')
         {
             steps[0] = 'l';
             steps[1] = 'c';
             return 2;
         }
-        else if(map[status.pos.y][status.pos.x-1]=='T') 
+        else if(cell_peek(agent, agent->status.pos.x-1, agent->status.pos.y)->map=='T') 
         {
             steps[0] = 'c';
             return 1;            
@@ -1758,289 +2655,1539 @@ int chop_tree(char* steps)
     return 0;    
 }
 
-// Get a step from src to dest, using A* search
-int get_path_a_star(int srcX, int srcY, int direction, int destX, int destY, char* path)
+// BFS over (x,y,direction) from the agent, every action costs 1, so it gives the true cost to every point
+// agent can reach. Only done once per decision, when first needed
+void field_build(Agent agent)
 {
-    int i,j,k= 0;
-
-    int analysed[MAP_SIZE][MAP_SIZE][4];
-    for(i=0; i<MAP_SIZE; ++i)
-    {
-        for(j=0; j<MAP_SIZE; ++j)
-        {
-            for(k=0; k<4; ++k)
-            {
-                analysed[i][j][k]=0;
-            }
-        }
-    }
-
-    AstarNodeHead queue = malloc(sizeof(struct astarNode));
-    queue->num = 0;
-    queue->list = NULL;
-
-    AstarNode head = astarNode_create(srcX, srcY, direction, 0, heuristic(srcX,srcY,destX,destY), (char)0, "nothing");
+    int head = 0;
+    int tail = 0;
+    Passable passable = agent_passable(agent);
+    STAT_TIMER_START(cycles);
+    STAT_ADD(field_builds, 1);
 
-    astarNode_insert(queue, head);
+    agent->field_id++;
+    agent->field_ready = true;
 
-    int ret = 100000;
+    int start = cell_id(agent, agent->status.pos.x, agent->status.pos.y);
+    field_visit(agent, cell_of(agent, start), agent->status.direction, 0, (char)0);
+    agent->field_queue[tail++] = start*4+agent->status.direction;
 
-    AstarNode stored=NULL;
-
-    while(queue->list!=NULL)
+    while(head!=tail)
     {
-        AstarNode temp = queue->list;
-        queue->list = temp->next;
-        queue->num--;
-        analysed[temp->y][temp->x][temp->direction] = 1;
-
-
-        if(temp->direction==NORTH)
+        int state = agent->field_queue[head++];
+        int id = state/4;
+        int dir = state%4;
+        struct cell* cell = cell_of(agent, id);
+        int dist = cell->field_dist[dir]+1;
+        int nx = cell_x(agent, id)+dir_dx[dir];
+        int ny = cell_y(agent, id)+dir_dy[dir];
+        int right = (dir+1)%4;
+        int left = (dir+3)%4;
+
+        // A passable point is known, so its chunk is allocated
+        if(passable(agent, nx, ny))
         {
-            if(accessable[temp->y-1][temp->x] && !analysed[temp->y-1][temp->x][NORTH])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y-1, NORTH, temp->g+1, 
-                        heuristic(temp->x, temp->y-1, destX, destY), 'f', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][EAST])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y, EAST, temp->g+1, 
-                        temp->h, 'r', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][WEST])
+            int next = cell_id(agent, nx, ny);
+            if(field_visit(agent, cell_of(agent, next), dir, dist, 'f'))
             {
-                AstarNode new = astarNode_create(temp->x, temp->y, WEST, temp->g+1, 
-                        temp->h, 'l', temp->steps);
-                astarNode_insert(queue, new);
+                agent->field_queue[tail++] = next*4+dir;
             }
         }
-        else if(temp->direction==EAST)
+        if(field_visit(agent, cell, right, dist, 'r'))
         {
-            if(accessable[temp->y][temp->x+1] && !analysed[temp->y][temp->x+1][EAST])
-            {
-                AstarNode new = astarNode_create(temp->x+1, temp->y, EAST, temp->g+1, 
-                        heuristic(temp->x+1, temp->y, destX, destY), 'f', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][SOUTH])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y, SOUTH, temp->g+1, 
-                        temp->h, 'r', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][NORTH])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y, NORTH, temp->g+1, 
-                        temp->h, 'l', temp->steps);
-                astarNode_insert(queue, new);
-            }            
+            agent->field_queue[tail++] = id*4+right;
         }
-        else if(temp->direction==SOUTH)
+        if(field_visit(agent, cell, left, dist, 'l'))
         {
-            if(accessable[temp->y+1][temp->x] && !analysed[temp->y+1][temp->x][SOUTH])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y+1, SOUTH, temp->g+1, 
-                        heuristic(temp->x, temp->y+1, destX, destY), 'f', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][WEST])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y, WEST, temp->g+1, 
-                        temp->h, 'r', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][EAST])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y, EAST, temp->g+1, 
-                        temp->h, 'l', temp->steps);
-                astarNode_insert(queue, new);
-            }             
+            agent->field_queue[tail++] = id*4+left;
         }
-        else if(temp->direction==WEST)
+    }
+    STAT_ADD(field_states, tail);
+    STAT_TIMER_STOP(field_cycles, cycles);
+}
+
+// Record how to get to a state if it is the first time, return false if already got there
+bool field_visit(Agent agent, struct cell* cell, int dir, int dist, char act)
+{
+    if(cell->field_stamp[dir]==agent->field_id) return false;
+    cell->field_stamp[dir] = agent->field_id;
+    cell->field_dist[dir] = dist;
+    cell->field_act[dir] = act;
+    return true;
+}
+
+// Cost of the cheapest path to (x,y) in any direction, -1 if can not get there
+int field_cost(Agent agent, int x, int y)
+{
+    return field_cell_cost(agent, cell_peek(agent, x, y));
+}
+
+// Cost of the cheapest path to a point, by its cell
+int field_cell_cost(Agent agent, const struct cell* cell)
+{
+    int k;
+    int ret = -1;
+    if(!agent->field_ready) field_build(agent);
+    for(k=0; k<4; ++k)
+    {
+        if(cell->field_stamp[k]==agent->field_id && (ret==-1 || cell->field_dist[k]<ret))
         {
-            if(accessable[temp->y][temp->x-1] && !analysed[temp->y][temp->x-1][WEST])
-            {
-                AstarNode new = astarNode_create(temp->x-1, temp->y, WEST, temp->g+1, 
-                        heuristic(temp->x-1, temp->y, destX, destY), 'f', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][NORTH])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y, NORTH, temp->g+1, 
-                        temp->h, 'r', temp->steps);
-                astarNode_insert(queue, new);
-            }
-            if(!analysed[temp->y][temp->x][SOUTH])
-            {
-                AstarNode new = astarNode_create(temp->x, temp->y, SOUTH, temp->g+1, 
-                        temp->h, 'l', temp->steps);
-                astarNode_insert(queue, new);
-            }              
+            ret = cell->field_dist[k];
         }
+    }
+    return ret;
+}
 
-        if(temp->f > ret) 
+// Cheapest of the four points next to (x,y), return its cost or -1 if can get to none of them
+int field_nearest_neighbor(Agent agent, int x, int y, struct point* at)
+{
+    int k;
+    int ret = -1;
+    for(k=0; k<4; ++k)
+    {
+        int cost = field_cost(agent, x+dir_dx[k], y+dir_dy[k]);
+        if(cost!=-1 && (ret==-1 || cost<ret))
         {
-            free(temp);
-            break;
+            ret = cost;
+            at->x = x+dir_dx[k];
+            at->y = y+dir_dy[k];
         }
-        
-        if(temp->x == destX && temp->y == destY)
+    }
+    return ret;
+}
+
+// Write the cheapest path to (x,y) in plan by walking the field back, return its length
+int field_path(Agent agent, int x, int y, Plan plan)
+{
+    int k;
+    int dir = -1;
+    if(!agent->field_ready) field_build(agent);
+    const struct cell* cell = cell_peek(agent, x, y);
+    for(k=0; k<4; ++k)
+    {
+        if(cell->field_stamp[k]==agent->field_id && (dir==-1 || cell->field_dist[k]<cell->field_dist[dir]))
         {
-            assert(temp->h==0);
-            if(temp->f < ret)
-            {
-                if(stored!=NULL) free(stored);
-                stored = temp;
-                ret = temp->f;
-                continue;
-            }
+            dir = k;
         }
-        free(temp);
     }
+    if(dir==-1) return 0;
 
-    AstarNode curr = queue->list;
-    AstarNode prev = queue->list;
-    if(curr!=NULL)
+    int ret = cell->field_dist[dir];
+    char* steps = plan_reserve(plan, ret);
+    if(ret>0) dstar_track(agent, x, y, agent_passable(agent), false);
+    for(k=ret-1; k>=0; --k)
     {
-        while(curr->next!=NULL)
+        char act = cell_peek(agent, x, y)->field_act[dir];
+        steps[k] = act;
+        if(act=='f')
         {
-            prev=curr;
-            curr=curr->next;
-            free(prev);
+            x -= dir_dx[dir];
+            y -= dir_dy[dir];
         }
-        free(curr);
+        else if(act=='r') dir = (dir+3)%4;
+        else dir = (dir+1)%4;
     }
-    free(queue);
+    return ret;
+}
 
-    for(i=0; i<stored->f; ++i)
+// 0-1 BFS from the agent over the land and the sea seen: a step on land costs no stone and a step on sea one, so
+// the deque only ever holds two costs, the ones to the front first. A point is pushed at most twice. Only done once
+// per decision, when first needed
+void stone_build(Agent agent)
+{
+    int cap = agent->cells_cap*2;
+    int head = 0;
+    int tail = 0;
+    int k;
+    STAT_TIMER_START(cycles);
+    STAT_ADD(stone_builds, 1);
+
+    agent->stone_id++;
+    agent->stone_ready = true;
+
+    int start = cell_id(agent, agent->status.pos.x, agent->status.pos.y);
+    struct cell* cell = cell_of(agent, start);
+    cell->stone_stamp = agent->stone_id;
+    cell->stone_cost = 0;
+    cell->stone_from = -1;
+    agent->stone_queue[tail++] = start;
+
+    while(head!=tail)
     {
-        path[i] = stored->steps[i];
+        int id = agent->stone_queue[head];
+        head = (head+1)%cap;
+        STAT_ADD(stone_cells, 1);
+        cell = cell_of(agent, id);
+        for(k=0; k<4; ++k)
+        {
+            int nx = cell_x(agent, id)+dir_dx[k];
+            int ny = cell_y(agent, id)+dir_dy[k];
+            int step;
+            if(passable_land(agent, nx, ny)) step = 0;
+            else if(passable_sea(agent, nx, ny)) step = 1;
+            else continue;
+
+            // Passable points are known, so their chunk is allocated
+            int next = cell_id(agent, nx, ny);
+            struct cell* near = cell_of(agent, next);
+            int cost = cell->stone_cost+step;
+            if(near->stone_stamp==agent->stone_id && near->stone_cost<=cost) continue;
+            near->stone_stamp = agent->stone_id;
+            near->stone_cost = cost;
+            near->stone_from = id;
+            if(step==0)
+            {
+                head = (head+cap-1)%cap;
+                agent->stone_queue[head] = next;
+            }
+            else
+            {
+                agent->stone_queue[tail] = next;
+                tail = (tail+1)%cap;
+            }
+        }
     }
-
-    free(stored);
-    return ret;
+    STAT_TIMER_STOP(stone_cycles, cycles);
 }
 
-// Heuristic function of two points on map
-int heuristic(int srcX, int srcY, int destX, int destY)
+// Fewest stones to get to (x,y), -1 if can not get there even with enough of them
+int stone_cost(Agent agent, int x, int y)
 {
-    return abs(srcX-destX)+abs(srcY-destY);
+    if(!agent->stone_ready) stone_build(agent);
+    const struct cell* cell = cell_peek(agent, x, y);
+    return cell->stone_stamp==agent->stone_id ? cell->stone_cost : -1;
 }
 
-bool is_accessable_lake(int srcX, int srcY, int destX, int destY)
+// The point of the map marked type which takes fewest stones to get to, at least one and no more than we have.
+// Ties go to the first in row order
+bool stone_target(Agent agent, char type, struct point* at)
 {
-    bool temp[2*abs(srcY-destY)+1][2*abs(srcX-destX)+1];
     int i, j;
-    for (i =0; i < 2*abs(srcY-destY)+1; ++i)
-    {
-        for(j=0; j < 2*abs(srcX-destX)+1; ++j)
-        {
-            temp[i][j]=false;
-        }
-    }    
-
-    bool changing = true;
-    temp[abs(srcY-destY)][abs(srcX-destX)] = true;
-    while(changing)
+    int best = -1;
+    for(i=agent->status.a.y; i<=agent->status.b.y; ++i)
     {
-        changing=false;
-        for (i =0; i < 2*abs(srcY-destY)+1; ++i)
+        for(j=agent->status.a.x; j<=agent->status.b.x; ++j)
         {
-            for(j=0; j < 2*abs(srcX-destX)+1; ++j)
+            if(cell_peek(agent, j, i)->map!=type) continue;
+            int cost = stone_cost(agent, j, i);
+            if(cost>0 && cost<=agent->status.num_stone && (best==-1 || cost<best))
             {
-                if((map[i-abs(srcY-destY)+srcY][j-abs(srcX-destX)+srcX]=='~'
-                    || map[i-abs(srcY-destY)+srcY][j-abs(srcX-destX)+srcX]=='o'
-                    || map[i-abs(srcY-destY)+srcY][j-abs(srcX-destX)+srcX]=='O'
-                    || map[i-abs(srcY-destY)+srcY][j-abs(srcX-destX)+srcX]=='$') && temp[i][j]==false)
-                {
-                    if( (i-1>=0 && temp[i-1][j]==true) 
-                        || (i+1<2*abs(srcY-destY)+1 && temp[i+1][j]==true) 
-                        || (j-1>0 && temp[i][j-1]==true) 
-                        || (j+1<2*abs(srcX-destX)+1 && temp[i][j+1]==true) )
-                    {
-                        temp[i][j]=true;
-                        changing=true;
-                    }
-                }
+                best = cost;
+                at->x = j;
+                at->y = i;
             }
         }
     }
-    return temp[destY-srcY+abs(srcY-destY)][destX-srcX+abs(srcX-destX)];
+    return best!=-1;
 }
 
-// Get action to send to server
-char interpret_action(char* steps, int curr_step) {
-
-    // REPLACE THIS CODE WITH AI TO CHOOSE ACTION
-
-    char ch= *(steps+curr_step);
+// Walk to the last land point before the first sea of the crossing to (x,y), and cross from there next decision.
+// Cross now if already there
+int stone_go(Agent agent, int x, int y, Plan plan)
+{
+    int id = cell_id(agent, x, y);
+    int shore = -1;
+    while(cell_of(agent, id)->stone_from!=-1)
+    {
+        int from = cell_of(agent, id)->stone_from;
+        if(cell_of(agent, from)->stone_cost==0 && cell_of(agent, id)->stone_cost==1) shore = from;
+        id = from;
+    }
+    int sx = cell_x(agent, shore);
+    int sy = cell_y(agent, shore);
+    if(sx==agent->status.pos.x && sy==agent->status.pos.y) return stone_path(agent, x, y, plan);
+
+    agent->go_on_lake = true;
+    agent->stoneX = x;
+    agent->stoneY = y;
+    return field_path(agent, sx, sy, plan);
+}
 
-    if(ch=='F' || ch=='f')
+// Write the path the stone field took to (x,y) in plan, turning to each next point, return its length
+int stone_path(Agent agent, int x, int y, Plan plan)
+{
+    int num = 0;
+    int len = 0;
+    int dir = agent->status.direction;
+    int id = cell_id(agent, x, y);
+    int k;
+
+    // The points from (x,y) back to the agent, the field is built so the deque is free
+    while(cell_of(agent, id)->stone_from!=-1)
     {
-        if(status.direction==NORTH)
-        {
-            --status.pos.y;
-        }
-        if(status.direction==EAST)
+        agent->stone_queue[num++] = id;
+        id = cell_of(agent, id)->stone_from;
+    }
+    char* steps = plan_reserve(plan, 3*num);
+    while(num>0)
+    {
+        int next = agent->stone_queue[--num];
+        int dx = cell_x(agent, next)-cell_x(agent, id);
+        int dy = cell_y(agent, next)-cell_y(agent, id);
+        for(k=0; dir_dx[k]!=dx || dir_dy[k]!=dy; ++k);
+        switch((k-dir+4)%4)
         {
-            ++status.pos.x;
+            case 1:
+                steps[len++] = 'r';
+                break;
+            case 2:
+                steps[len++] = 'r';
+                steps[len++] = 'r';
+                break;
+            case 3:
+                steps[len++] = 'l';
+                break;
         }
-        if(status.direction==SOUTH)
+        steps[len++] = 'f';
+        dir = k;
+        id = next;
+    }
+    return len;
+}
+
+// A* over the inventory labels from the agent, see plan_search in the header. Return the length of the plan, 0 if
+// the goal can not be got to on the known map
+int plan_search(Agent agent, int goal, Plan plan)
+{
+    struct planLabel start;
+    int found = -1;
+    int i, j, k;
+    bool sail = cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map=='~';
+    int inventory = agent->status.key | agent->status.axe<<1 | agent->status.raft<<2 | sail<<3
+                    | agent->status.treasure<<4 | agent->status.num_stone<<8 | agent->status.num_dynamite<<16;
+
+    if(goal==PLAN_WIN && agent->Treasure==NULL && !agent->status.treasure) return 0;
+    if(agent->plan_failed[goal] && agent->plan_fail_inventory[goal]==inventory) return 0;
+    STAT_TIMER_START(cycles);
+    STAT_ADD(plan_searches, 1);
+
+    // The items it tells apart, the first ones in row order
+    agent->plan_items_num = 0;
+    for(i=agent->status.a.y; i<=agent->status.b.y && agent->plan_items_num<PLAN_MAX_ITEMS; ++i)
+    {
+        for(j=agent->status.a.x; j<=agent->status.b.x && agent->plan_items_num<PLAN_MAX_ITEMS; ++j)
         {
-            ++status.pos.y;
+            char c = cell_peek(agent, j, i)->map;
+            if(c=='o' || c=='d' || c=='T') agent->plan_items[agent->plan_items_num++] = cell_id(agent, j, i);
         }
-        if(status.direction==WEST)
+    }
+
+    agent->plan_id++;
+    agent->plan_labels_num = 0;
+    agent->plan_open_num = 0;
+    for(k=0; k<PLAN_BUCKETS; ++k) agent->plan_open[k] = -1;
+    start.cell = cell_id(agent, agent->status.pos.x, agent->status.pos.y);
+    start.dir = agent->status.direction;
+    start.have = (agent->status.key ? PLAN_KEY : 0) | (agent->status.axe ? PLAN_AXE : 0)
+                 | (agent->status.raft || sail ? PLAN_RAFT : 0) | (sail ? PLAN_SAIL : 0)
+                 | (agent->status.treasure ? PLAN_TREASURE : 0);
+    start.stones = agent->status.num_stone;
+    start.dynamite = agent->status.num_dynamite;
+    start.used = 0;
+    start.g = 0;
+    start.f = plan_h(agent, goal, &start);
+    start.parent = -1;
+    start.act[0] = start.act[1] = 0;
+    agent->plan_open_f = start.f;
+    plan_label_add(agent, &start);
+
+    while(agent->plan_open_num>0)
+    {
+        int index = plan_pop(agent);
+        // Copied, plan_labels may move when labels are added
+        struct planLabel curr = agent->plan_labels[index];
+        if(curr.dead) continue;
+        if(goal==PLAN_WIN ? (curr.have&PLAN_TREASURE) && curr.cell==cell_id(agent, START_POINT, START_POINT)
+                          : curr.g>0 && cell_of(agent, curr.cell)->frontier_slot>0)
         {
-            --status.pos.x;
+            found = index;
+            break;
         }
-        if(map[status.pos.y][status.pos.x]=='~')
+        if(agent->plan_labels_num>=PLAN_MAX_LABELS) break;
+        STAT_ADD(plan_expanded, 1);
+
+        // Turn left, turn right, move forward
+        for(k=0; k<3; ++k)
         {
-            if(status.num_stone>0) 
+            struct planLabel next = curr;
+            next.parent = index;
+            next.act[1] = 0;
+            if(k<2)
             {
-                status.num_stone--;
-                map[status.pos.y][status.pos.x]='O';
+                next.dir = (curr.dir+(k==0 ? 3 : 1))%4;
+                next.act[0] = k==0 ? 'l' : 'r';
+                next.g = curr.g+1;
             }
-            else status.raft=false;
+            else if(!plan_step(agent, &curr, &next)) continue;
+            next.f = next.g+plan_h(agent, goal, &next);
+            plan_label_add(agent, &next);
         }
-        return ch;
     }
-    else if(ch=='L' || ch=='l')
+    STAT_ADD(plan_labels, agent->plan_labels_num);
+    STAT_TIMER_STOP(plan_cycles, cycles);
+
+    if(found==-1)
     {
-        --status.direction;
-        if(status.direction<NORTH)
-            status.direction=WEST;
+        agent->plan_failed[goal] = true;
+        agent->plan_fail_inventory[goal] = inventory;
+        // Every label was tried, so only a change next to the points they got to can make it succeed.
+        // Given up at PLAN_MAX_LABELS, any change can
+        agent->plan_fail_id = goal==PLAN_WIN && agent->plan_open_num==0 ? agent->plan_id : -1;
+        for(k=0; k<agent->plan_labels_num && agent->plan_fail_id!=-1; ++k)
+        {
+            cell_of(agent, agent->plan_labels[k].cell)->plan_reached = agent->plan_id;
+        }
+        return 0;
+    }
 
-        return ch;
+    // Follow the parents back, a label is one or two actions (g also has the price of the blasts)
+    int ret = 0;
+    for(k=found; agent->plan_labels[k].parent!=-1; k=agent->plan_labels[k].parent)
+    {
+        ret += agent->plan_labels[k].act[1]!=0 ? 2 : 1;
     }
-    else if(ch=='R' || ch=='r')
+    char* steps = plan_reserve(plan, ret);
+    i = ret;
+    for(k=found; agent->plan_labels[k].parent!=-1; k=agent->plan_labels[k].parent)
     {
-        ++status.direction;
-        if(status.direction>WEST)
-            status.direction=NORTH; 
-
-        return ch;      
+        if(agent->plan_labels[k].act[1]!=0) steps[--i] = agent->plan_labels[k].act[1];
+        steps[--i] = agent->plan_labels[k].act[0];
+    }
+    return ret;
+}
+
+// Move forward as the engine does: pick up what is there, open a door or chop a tree first, and on the sea keep
+// sailing, else put a stone, else get on the raft
+bool plan_step(Agent agent, const struct planLabel* from, struct planLabel* to)
+{
+    int x = cell_x(agent, from->cell)+dir_dx[from->dir];
+    int y = cell_y(agent, from->cell)+dir_dy[from->dir];
+    const struct cell* cell = cell_find(agent, x, y);
+    if(cell==NULL || !cell->seen) return false;
+
+    int id = cell_id(agent, x, y);
+    int item = -1;
+    char c = cell->map;
+    if(c=='o' || c=='d' || c=='T' || c=='-' || c=='*')
+    {
+        item = plan_item(agent, id);
+        if(item!=-1 && (from->used>>item&1)) c = ' ';
+    }
+
+    to->cell = id;
+    to->g = from->g+1;
+    to->act[0] = 'f';
+
+    // Blast what can not be opened or chopped
+    if(c=='*' || (c=='-' && !(from->have&PLAN_KEY)) || (c=='T' && !(from->have&PLAN_AXE)))
+    {
+        if(from->dynamite==0) return false;
+        to->act[0] = 'b';
+        to->act[1] = 'f';
+        to->g += 1+PLAN_BLAST_PRICE/from->dynamite;
+        to->dynamite--;
+        item = plan_item_add(agent, id);
+        if(item!=-1) to->used |= 1u<<item;
+        c = ' ';
+    }
+    switch(c)
+    {
+        case '-':
+            to->act[0] = 'u';
+            to->act[1] = 'f';
+            to->g++;
+            item = plan_item_add(agent, id);
+            if(item!=-1) to->used |= 1u<<item;
+            break;
+        case 'T':
+            to->act[0] = 'c';
+            to->act[1] = 'f';
+            to->g++;
+            // A tree not told apart may be chopped already, so it is not counted on for a raft
+            if(item!=-1)
+            {
+                to->have |= PLAN_RAFT;
+                to->used |= 1u<<item;
+            }
+            break;
+        case '~':
+            if(from->have&PLAN_SAIL) break;
+            if(from->stones>0) to->stones--;
+            else if(from->have&PLAN_RAFT) to->have |= PLAN_SAIL;
+            else return false;
+            break;
+        case 'o':
+            if(item!=-1)
+            {
+                to->stones++;
+                to->used |= 1u<<item;
+            }
+            break;
+        case 'd':
+            if(item!=-1)
+            {
+                to->dynamite++;
+                to->used |= 1u<<item;
+            }
+            break;
+        case 'k':
+            to->have |= PLAN_KEY;
+            break;
+        case 'a':
+            to->have |= PLAN_AXE;
+            break;
+        case '$':
+            to->have |= PLAN_TREASURE;
+            break;
+        case ' ':
+        case 'O':
+            break;
+        default:
+            return false;
+    }
+    // Landing loses the raft
+    if(c!='~' && (from->have&PLAN_SAIL)) to->have &= ~(PLAN_SAIL|PLAN_RAFT);
+    return true;
+}
+
+// Doors and walls get a bit the first time a label opens them, the labels which did not have it clear
+int plan_item_add(Agent agent, int id)
+{
+    int item = plan_item(agent, id);
+    if(item!=-1 || agent->plan_items_num==PLAN_MAX_ITEMS) return item;
+    agent->plan_items[agent->plan_items_num] = id;
+    return agent->plan_items_num++;
+}
+
+// The failed PLAN_WIN search only looked at the points it got to and the ones next to them
+void plan_note(Agent agent, int x, int y)
+{
+    int k;
+    agent->plan_failed[PLAN_EXPLORE] = false;
+    if(!agent->plan_failed[PLAN_WIN]) return;
+    if(agent->plan_fail_id==-1 || cell_peek(agent, x, y)->plan_reached==agent->plan_fail_id)
+    {
+        agent->plan_failed[PLAN_WIN] = false;
+        return;
+    }
+    for(k=0; k<4; ++k)
+    {
+        if(cell_peek(agent, x+dir_dx[k], y+dir_dy[k])->plan_reached==agent->plan_fail_id)
+        {
+            agent->plan_failed[PLAN_WIN] = false;
+            return;
+        }
+    }
+}
+
+// Index of a point in plan_items, -1 if not one
+int plan_item(Agent agent, int id)
+{
+    int k;
+    for(k=0; k<agent->plan_items_num; ++k)
+    {
+        if(agent->plan_items[k]==id) return k;
+    }
+    return -1;
+}
+
+// Manhattan distance to the start, through the treasure if not got yet. Nothing for the frontier
+int plan_h(Agent agent, int goal, const struct planLabel* label)
+{
+    if(goal!=PLAN_WIN) return 0;
+    int x = cell_x(agent, label->cell);
+    int y = cell_y(agent, label->cell);
+    if(label->have&PLAN_TREASURE) return heuristic(x, y, START_POINT, START_POINT);
+    return heuristic(x, y, agent->Treasure->x, agent->Treasure->y)
+           +heuristic(agent->Treasure->x, agent->Treasure->y, START_POINT, START_POINT);
+}
+
+// On the sea or not must be the same, the raft is held or not
+bool plan_dominates(const struct planLabel* a, const struct planLabel* b)
+{
+    return a->g<=b->g && (a->have&b->have)==b->have && ((a->have^b->have)&PLAN_SAIL)==0
+           && a->stones>=b->stones && a->dynamite>=b->dynamite && (a->used&~b->used)==0;
+}
+
+// Labels dominated by the new one are marked dead and skipped when popped
+void plan_label_add(Agent agent, const struct planLabel* label)
+{
+    struct cell* cell = cell_of(agent, label->cell);
+    int dir = label->dir;
+    int k;
+
+    if(cell->plan_stamp[dir]!=agent->plan_id)
+    {
+        cell->plan_stamp[dir] = agent->plan_id;
+        cell->plan_head[dir] = -1;
+    }
+    for(k=cell->plan_head[dir]; k!=-1; k=agent->plan_labels[k].next)
+    {
+        if(!agent->plan_labels[k].dead && plan_dominates(&agent->plan_labels[k], label)) return;
+    }
+    for(k=cell->plan_head[dir]; k!=-1; k=agent->plan_labels[k].next)
+    {
+        if(plan_dominates(label, &agent->plan_labels[k])) agent->plan_labels[k].dead = true;
+    }
+
+    if(agent->plan_labels_num==agent->plan_labels_cap)
+    {
+        agent->plan_labels_cap = MAX(2*agent->plan_labels_cap, 1024);
+        agent->plan_labels = realloc(agent->plan_labels, agent->plan_labels_cap*sizeof(struct planLabel));
+        assert(agent->plan_labels!=NULL);
+    }
+    int index = agent->plan_labels_num++;
+    agent->plan_labels[index] = *label;
+    agent->plan_labels[index].dead = false;
+    agent->plan_labels[index].next = cell->plan_head[dir];
+    cell->plan_head[dir] = index;
+    plan_push(agent, index);
+}
+
+// A step costs 1 to 2+PLAN_BLAST_PRICE and the heuristic changes by 1 at most, so a new label has f at most PLAN_BUCKETS-1 more
+// than the one popped, and PLAN_BUCKETS lists (by f modulo) are enough. The last pushed is near the goal most often
+void plan_push(Agent agent, int label)
+{
+    PlanLabel l = &agent->plan_labels[label];
+    agent->plan_open_num++;
+    l->open_next = agent->plan_open[l->f%PLAN_BUCKETS];
+    agent->plan_open[l->f%PLAN_BUCKETS] = label;
+}
+
+int plan_pop(Agent agent)
+{
+    int* bucket;
+    while(*(bucket = &agent->plan_open[agent->plan_open_f%PLAN_BUCKETS])==-1) agent->plan_open_f++;
+    int ret = *bucket;
+    *bucket = agent->plan_labels[ret].open_next;
+    agent->plan_open_num--;
+    return ret;
+}
+
+// Get a path from src to dest, using A* search. Both modes give a path of the fewest actions, ASTAR_BIDIRECTIONAL
+// expands fewer states when dest is far, ASTAR_FORWARD is cheaper to start when it is near. Every heuristic gives
+// the same number of actions, the tighter ones expand fewer states
+int get_path_a_star(Agent agent, int srcX, int srcY, int direction, int destX, int destY, Passable passable, int mode,
+                    Heuristic heuristic, Plan path)
+{
+    int ret;
+    if(heuristic==heuristic_alt) alt_prepare(agent, passable, srcX, srcY);
+    STAT_TIMER_START(cycles);
+    STAT_ADD(astar_searches, 1);
+
+    if(mode==ASTAR_BIDIRECTIONAL)
+    {
+        STAT_ADD(astar_bidir_searches, 1);
+        ret = astar_bidirectional(agent, srcX, srcY, direction, destX, destY, passable, heuristic, path);
+    }
+    else
+    {
+        ret = astar_forward(agent, srcX, srcY, direction, destX, destY, passable, heuristic, path);
+    }
+
+    STAT_TIMER_STOP(astar_cycles, cycles);
+    if(ret==-1) return 0;
+
+    // Paths from the agent are followed with D* Lite
+    if(srcX==agent->status.pos.x && srcY==agent->status.pos.y && direction==agent->status.direction && ret>0)
+    {
+        dstar_track(agent, destX, destY, passable, true);
+    }
+    return ret;
+}
+
+// A* from src, write the actions to path and return how many, -1 if dest can not be got to
+int astar_forward(Agent agent, int srcX, int srcY, int direction, int destX, int destY, Passable passable,
+                  Heuristic heuristic, Plan path)
+{
+    int i;
+
+    // A state is analysed in this search if it is stamped with this search's number,
+    // so no need to clear the whole array every time
+    int search_id = ++agent->astar_search_id;
+
+    // Nodes of last search are not needed any more, reuse the arena
+    agent->astar_arena_size = 0;
+
+    struct astarNodeHead open_list;
+    AstarNodeHead queue = &open_list;
+    astar_queue_init(agent, queue, ASTAR_FROM_SRC);
+
+    astarNode_insert(agent, queue, astarNode_create(agent, srcX, srcY, direction, 0,
+            heuristic(agent, ASTAR_FROM_SRC, srcX, srcY, direction, destX, destY), (char)0, -1));
+
+    int ret = 0;
+
+    int stored = -1;
+
+    while(queue->num>0)
+    {
+        int curr = astarNode_pop(agent, queue);
+        AstarNode temp = &agent->astar_arena[curr];
+        cell_at(agent, temp->x, temp->y)->astar_analysed[ASTAR_FROM_SRC][temp->direction] = search_id;
+
+        // The heuristic is consistent, so the first node at dest popped is the cheapest
+        if(temp->x == destX && temp->y == destY)
+        {
+            assert(temp->h==0);
+            stored = curr;
+            ret = temp->f;
+            break;
+        }
+
+        astar_expand(agent, queue, curr, srcX, srcY, destX, destY, passable, heuristic, search_id);
+    }
+
+    astar_queue_clear(agent, queue);
+    if(stored==-1) return -1;
+
+    // Follow the parents back from the goal, each node is one action
+    char* steps = plan_reserve(path, ret);
+    int curr = stored;
+    for(i=ret-1; i>=0; --i)
+    {
+        steps[i] = agent->astar_arena[curr].act;
+        curr = agent->astar_arena[curr].parent;
+    }
+
+    return ret;
+}
+
+// Bidirectional A*: one side from src with the heuristic to dest, one from dest in every direction with the heuristic
+// from src. The side whose lowest f is higher is expanded (the one with fewer open nodes on a tie), as the
+// search ends when the higher of the two gets to the best join. The two sides meet at a point and not only at
+// a state, as they may face different ways there: a state popped is joined with each direction the other side got to
+// at its point, with the turns from the one to the other. Both heuristics are consistent, so a path through an open
+// node costs at least its f, and once the lowest f of either side is no less than the best join none is cheaper.
+// Write the actions to path and return how many, -1 if dest can not be got to
+int astar_bidirectional(Agent agent, int srcX, int srcY, int direction, int destX, int destY, Passable passable,
+                        Heuristic heuristic, Plan path)
+{
+    int i, d, side;
+    int search_id = ++agent->astar_search_id;
+    agent->astar_arena_size = 0;
+
+    struct astarNodeHead open_list[2];
+    astar_queue_init(agent, &open_list[ASTAR_FROM_SRC], ASTAR_FROM_SRC);
+    astar_queue_init(agent, &open_list[ASTAR_FROM_DEST], ASTAR_FROM_DEST);
+
+    astarNode_insert(agent, &open_list[ASTAR_FROM_SRC], astarNode_create(agent, srcX, srcY, direction, 0,
+            heuristic(agent, ASTAR_FROM_SRC, srcX, srcY, direction, destX, destY), (char)0, -1));
+    for(d=0; d<4; ++d)
+    {
+        astarNode_insert(agent, &open_list[ASTAR_FROM_DEST], astarNode_create(agent, destX, destY, d, 0,
+                heuristic(agent, ASTAR_FROM_DEST, destX, destY, d, srcX, srcY), (char)0, -1));
+    }
+
+    // Cheapest join so far, and the node of each side it joins
+    int best = -1;
+    int meet[2] = { -1, -1 };
+
+    while(open_list[ASTAR_FROM_SRC].num>0 && open_list[ASTAR_FROM_DEST].num>0)
+    {
+        int low_src = agent->astar_arena[open_list[ASTAR_FROM_SRC].heap[0]].f;
+        int low_dest = agent->astar_arena[open_list[ASTAR_FROM_DEST].heap[0]].f;
+        if(best!=-1 && MAX(low_src, low_dest)>=best) break;
+
+        if(low_src!=low_dest) side = low_src>low_dest ? ASTAR_FROM_SRC : ASTAR_FROM_DEST;
+        else side = open_list[ASTAR_FROM_SRC].num<=open_list[ASTAR_FROM_DEST].num ? ASTAR_FROM_SRC : ASTAR_FROM_DEST;
+        int curr = astarNode_pop(agent, &open_list[side]);
+        STAT_ADD(astar_bidir_expanded, 1);
+        AstarNode temp = &agent->astar_arena[curr];
+        struct cell* cell = cell_at(agent, temp->x, temp->y);
+        cell->astar_analysed[side][temp->direction] = search_id;
+        cell->astar_node[side][temp->direction] = curr;
+
+        for(d=0; d<4; ++d)
+        {
+            int other = astar_reached(agent, &open_list[1-side], cell, d, search_id);
+            if(other==-1) continue;
+            int from = side==ASTAR_FROM_SRC ? curr : other;
+            int to = side==ASTAR_FROM_SRC ? other : curr;
+            int turns = (agent->astar_arena[to].direction-agent->astar_arena[from].direction+4)%4;
+            int cost = agent->astar_arena[from].g+(turns==3 ? 1 : turns)+agent->astar_arena[to].g;
+            if(best==-1 || cost<best)
+            {
+                best = cost;
+                meet[ASTAR_FROM_SRC] = from;
+                meet[ASTAR_FROM_DEST] = to;
+            }
+        }
+
+        astar_expand(agent, &open_list[side], curr, srcX, srcY, destX, destY, passable, heuristic, search_id);
+    }
+
+    astar_queue_clear(agent, &open_list[ASTAR_FROM_SRC]);
+    astar_queue_clear(agent, &open_list[ASTAR_FROM_DEST]);
+    if(best==-1) return -1;
+
+    // The side from src back from the meeting, the turns there, then the side from dest down to it
+    char* steps = plan_reserve(path, best);
+    AstarNode from = &agent->astar_arena[meet[ASTAR_FROM_SRC]];
+    AstarNode to = &agent->astar_arena[meet[ASTAR_FROM_DEST]];
+    int k = from->g;
+    int turns = (to->direction-from->direction+4)%4;
+    for(i=meet[ASTAR_FROM_SRC]; agent->astar_arena[i].parent!=-1; i=agent->astar_arena[i].parent)
+    {
+        steps[--k] = agent->astar_arena[i].act;
+    }
+    k = from->g;
+    if(turns==3) steps[k++] = 'l';
+    else for(i=0; i<turns; ++i) steps[k++] = 'r';
+    for(i=meet[ASTAR_FROM_DEST]; agent->astar_arena[i].parent!=-1; i=agent->astar_arena[i].parent)
+    {
+        steps[k++] = agent->astar_arena[i].act;
+    }
+    assert(k==best);
+
+    return best;
+}
+
+// From src: the states the three actions get to. From dest: the states with an action getting to this one, a move
+// only from a point which can be entered or src, into one which can be entered
+void astar_expand(Agent agent, AstarNodeHead queue, int curr, int srcX, int srcY, int destX, int destY, Passable passable,
+                  Heuristic heuristic, int search_id)
+{
+    int side = queue->side;
+    // Copy out what we need, astar_arena may move when nodes are created
+    int x = agent->astar_arena[curr].x;
+    int y = agent->astar_arena[curr].y;
+    int dir = agent->astar_arena[curr].direction;
+    int g = agent->astar_arena[curr].g;
+    int right = (dir+1)%4;
+    int left = (dir+3)%4;
+
+    if(side==ASTAR_FROM_SRC)
+    {
+        int nx = x+dir_dx[dir];
+        int ny = y+dir_dy[dir];
+        if(astar_can_enter(agent, passable, nx, ny, destX, destY) && cell_peek(agent, nx, ny)->astar_analysed[side][dir]!=search_id)
+        {
+            astarNode_insert(agent, queue, astarNode_create(agent, nx, ny, dir, g+1,
+                    heuristic(agent, side, nx, ny, dir, destX, destY), 'f', curr));
+        }
+        if(cell_peek(agent, x, y)->astar_analysed[side][right]!=search_id)
+        {
+            astarNode_insert(agent, queue, astarNode_create(agent, x, y, right, g+1,
+                    heuristic(agent, side, x, y, right, destX, destY), 'r', curr));
+        }
+        if(cell_peek(agent, x, y)->astar_analysed[side][left]!=search_id)
+        {
+            astarNode_insert(agent, queue, astarNode_create(agent, x, y, left, g+1,
+                    heuristic(agent, side, x, y, left, destX, destY), 'l', curr));
+        }
+    }
+    else
+    {
+        int px = x-dir_dx[dir];
+        int py = y-dir_dy[dir];
+        if(astar_can_enter(agent, passable, x, y, destX, destY)
+           && (astar_can_enter(agent, passable, px, py, destX, destY) || (px==srcX && py==srcY))
+           && cell_peek(agent, px, py)->astar_analysed[side][dir]!=search_id)
+        {
+            astarNode_insert(agent, queue, astarNode_create(agent, px, py, dir, g+1,
+                    heuristic(agent, side, px, py, dir, srcX, srcY), 'f', curr));
+        }
+        // Turning right from the left of dir faces dir, and left from the right
+        if(cell_peek(agent, x, y)->astar_analysed[side][left]!=search_id)
+        {
+            astarNode_insert(agent, queue, astarNode_create(agent, x, y, left, g+1,
+                    heuristic(agent, side, x, y, left, srcX, srcY), 'r', curr));
+        }
+        if(cell_peek(agent, x, y)->astar_analysed[side][right]!=search_id)
+        {
+            astarNode_insert(agent, queue, astarNode_create(agent, x, y, right, g+1,
+                    heuristic(agent, side, x, y, right, srcX, srcY), 'l', curr));
+        }
+    }
+}
+
+// Analysed nodes are found by the stamp, open ones by their heap slot
+int astar_reached(Agent agent, AstarNodeHead queue, const struct cell* cell, int dir, int search_id)
+{
+    (void)agent;
+    if(cell->astar_analysed[queue->side][dir]==search_id) return cell->astar_node[queue->side][dir];
+    if(cell->astar_index[queue->side][dir]!=0) return queue->heap[cell->astar_index[queue->side][dir]-1];
+    return -1;
+}
+
+void astar_queue_init(Agent agent, AstarNodeHead queue, int side)
+{
+    queue->side = side;
+    queue->num = 0;
+    queue->seq = 0;
+    queue->heap = agent->astar_heap[side];
+}
+
+void astar_queue_clear(Agent agent, AstarNodeHead queue)
+{
+    int i;
+    for(i=0; i<queue->num; ++i)
+    {
+        AstarNode left = &agent->astar_arena[queue->heap[i]];
+        cell_at(agent, left->x, left->y)->astar_index[queue->side][left->direction] = 0;
+    }
+    queue->num = 0;
+}
+
+// The destination can always be entered, even it is not passable, e.g. the sea from the land
+bool astar_can_enter(Agent agent, Passable passable, int x, int y, int destX, int destY)
+{
+    return (x==destX && y==destY) || passable(agent, x, y);
+}
+
+// Create a node in the arena, return its index
+int astarNode_create(Agent agent, int x, int y, int direction, int g, int h, char act, int parent)
+{
+    if(agent->astar_arena_size==agent->astar_arena_cap)
+    {
+        agent->astar_arena_cap = MAX(2*agent->astar_arena_cap, 1024);
+        agent->astar_arena = realloc(agent->astar_arena, agent->astar_arena_cap*sizeof(struct astarNode));
+        assert(agent->astar_arena!=NULL);
+    }
+    AstarNode ret = &agent->astar_arena[agent->astar_arena_size];
+    ret->x=x;
+    ret->y=y;
+    ret->direction=direction;
+    ret->g=g;
+    ret->h=h;
+    ret->f=g+h;
+    ret->seq=0;
+    ret->parent=parent;
+    ret->act=act;
+    return agent->astar_arena_size++;
+}
+
+void astarNode_insert(Agent agent, AstarNodeHead queue, int node)
+{
+    AstarNode new = &agent->astar_arena[node];
+    int slot = cell_peek(agent, new->x, new->y)->astar_index[queue->side][new->direction];
+    new->seq = queue->seq++;
+
+    // Find a node in same state
+    if(slot!=0)
+    {
+        AstarNode curr = &agent->astar_arena[queue->heap[slot-1]];
+        // Existing one is more efficient, don't insert, the new node just stays unused in arena
+        if(curr->f < new->f) return;
+        // Replace existing one, it moves behind nodes with the same f
+        STAT_ADD(astar_reinserted, 1);
+        queue->heap[slot-1] = node;
+        astarNode_sift_up(agent, queue, slot-1);
+        astarNode_sift_down(agent, queue, cell_peek(agent, new->x, new->y)->astar_index[queue->side][new->direction]-1);
+        return;
+    }
+
+    STAT_ADD(astar_pushed, 1);
+    queue->heap[queue->num] = node;
+    cell_at(agent, new->x, new->y)->astar_index[queue->side][new->direction] = queue->num+1;
+    queue->num++;
+    astarNode_sift_up(agent, queue, queue->num-1);
+}
+
+int astarNode_pop(Agent agent, AstarNodeHead queue)
+{
+    assert(queue->num>0);
+    STAT_ADD(astar_popped, 1);
+    int ret = queue->heap[0];
+    cell_at(agent, agent->astar_arena[ret].x, agent->astar_arena[ret].y)->astar_index[queue->side][agent->astar_arena[ret].direction] = 0;
+    queue->num--;
+    if(queue->num>0)
+    {
+        queue->heap[0] = queue->heap[queue->num];
+        astarNode_sift_down(agent, queue, 0);
+    }
+    return ret;
+}
+
+// Whether node a should be expanded before node b
+bool astarNode_before(Agent agent, int a, int b)
+{
+    return agent->astar_arena[a].f < agent->astar_arena[b].f
+        || (agent->astar_arena[a].f == agent->astar_arena[b].f && agent->astar_arena[a].seq < agent->astar_arena[b].seq);
+}
+
+void astarNode_sift_up(Agent agent, AstarNodeHead queue, int i)
+{
+    int node = queue->heap[i];
+    while(i>0)
+    {
+        int parent = (i-1)/2;
+        if(!astarNode_before(agent, node, queue->heap[parent])) break;
+        queue->heap[i] = queue->heap[parent];
+        cell_at(agent, agent->astar_arena[queue->heap[i]].x, agent->astar_arena[queue->heap[i]].y)->astar_index[queue->side][agent->astar_arena[queue->heap[i]].direction] = i+1;
+        i = parent;
+    }
+    queue->heap[i] = node;
+    cell_at(agent, agent->astar_arena[node].x, agent->astar_arena[node].y)->astar_index[queue->side][agent->astar_arena[node].direction] = i+1;
+}
+
+void astarNode_sift_down(Agent agent, AstarNodeHead queue, int i)
+{
+    int node = queue->heap[i];
+    while(2*i+1 < queue->num)
+    {
+        int child = 2*i+1;
+        if(child+1 < queue->num && astarNode_before(agent, queue->heap[child+1], queue->heap[child])) child++;
+        if(!astarNode_before(agent, queue->heap[child], node)) break;
+        queue->heap[i] = queue->heap[child];
+        cell_at(agent, agent->astar_arena[queue->heap[i]].x, agent->astar_arena[queue->heap[i]].y)->astar_index[queue->side][agent->astar_arena[queue->heap[i]].direction] = i+1;
+        i = child;
+    }
+    queue->heap[i] = node;
+    cell_at(agent, agent->astar_arena[node].x, agent->astar_arena[node].y)->astar_index[queue->side][agent->astar_arena[node].direction] = i+1;
+}
+
+void dstar_track(Agent agent, int x, int y, Passable passable, bool enter)
+{
+    agent->dstar_on = true;
+    agent->dstar_started = false;
+    agent->dstar_dirty = false;
+    agent->dstar_enter = enter;
+    agent->dstar_goal.x = x;
+    agent->dstar_goal.y = y;
+    agent->dstar_passable = passable;
+}
+
+// Take the move and the points changed by the last view. The search is only made when first needed, then it
+// already has everything known
+void dstar_note(Agent agent)
+{
+    int k,d;
+    if(!agent->dstar_on) return;
+    if(agent->changed_num>0) agent->dstar_dirty = true;
+    if(!agent->dstar_started) return;
+
+    // Keys in the open list are lower bounds by how far the agent went
+    if(agent->dstar_last.x!=agent->status.pos.x || agent->dstar_last.y!=agent->status.pos.y)
+    {
+        agent->dstar_km += heuristic(agent->dstar_last.x, agent->dstar_last.y, agent->status.pos.x, agent->status.pos.y);
+        agent->dstar_last = agent->status.pos;
+    }
+
+    // Whether a point can be stepped on only depends on the point, so only the moves into it changed
+    for(k=0; k<agent->changed_num; ++k)
+    {
+        for(d=0; d<4; ++d)
+        {
+            int x = agent->changed[k].x-dir_dx[d];
+            int y = agent->changed[k].y-dir_dy[d];
+            if(cell_find(agent, x, y)!=NULL) dstar_update(agent, cell_id(agent, x, y)*4+d);
+        }
+    }
+}
+
+// If the map changed, bring the search up to date and compare it with the rest of the plan: a plan blocked or longer
+// than the best path now is replaced by that path, a goal which can not be got to any more drops it
+void dstar_check(Agent agent)
+{
+    int start, cost, left, n;
+    if(!agent->dstar_on || !agent->dstar_dirty) return;
+    if(agent->curr_step>=agent->num_of_steps) return;
+    STAT_TIMER_START(cycles);
+    STAT_ADD(dstar_checks, 1);
+    agent->dstar_dirty = false;
+
+    if(!agent->dstar_started) dstar_start(agent);
+    dstar_compute(agent);
+
+    start = cell_id(agent, agent->status.pos.x, agent->status.pos.y)*4+agent->status.direction;
+    cost = dstar_g(agent, start);
+    left = plan_remaining(agent);
+    if(cost>=DSTAR_INF)
+    {
+        STAT_ADD(plans_dropped, 1);
+        agent->num_of_steps = agent->curr_step;
+        agent->dstar_on = false;
+    }
+    else if(left==-1 || cost<left)
+    {
+        // Walk down the costs from the agent, each state one action
+        STAT_ADD(plans_repaired, 1);
+        char* steps = plan_reserve(&agent->agent_plan, cost);
+        int state = start;
+        for(n=0; n<cost && state/4!=agent->dstar_goal_id; ++n)
+        {
+            dstar_best(agent, state, &state, &steps[n]);
+        }
+        agent->num_of_steps = n;
+        agent->curr_step = 0;
+    }
+    STAT_TIMER_STOP(dstar_cycles, cycles);
+}
+
+void dstar_start(Agent agent)
+{
+    int dir;
+    struct cell* goal = cell_at(agent, agent->dstar_goal.x, agent->dstar_goal.y);
+
+    // A state is in this search if stamped with its number, so nothing to clear
+    agent->dstar_id++;
+    agent->dstar_started = true;
+    agent->dstar_num = 0;
+    agent->dstar_km = 0;
+    agent->dstar_last = agent->status.pos;
+    agent->dstar_goal_id = cell_id(agent, agent->dstar_goal.x, agent->dstar_goal.y);
+    for(dir=0; dir<4; ++dir)
+    {
+        dstar_touch(agent, goal, dir);
+        goal->dstar_rhs[dir] = 0;
+        dstar_push(agent, agent->dstar_goal_id*4+dir);
+    }
+}
+
+// Expand states until the one of the agent is consistent and nothing open can make it cheaper
+void dstar_compute(Agent agent)
+{
+    int start = cell_id(agent, agent->status.pos.x, agent->status.pos.y)*4+agent->status.direction;
+    struct cell* at = cell_of(agent, start/4);
+    struct dstarKey top, now, goal;
+    int preds[3];
+    int i,n;
+
+    dstar_touch(agent, at, start%4);
+    while(agent->dstar_num>0)
+    {
+        dstar_key(agent, start, &goal);
+        top = agent->dstar_heap[0];
+        if(!dstar_before(&top, &goal) && at->dstar_g[start%4]==at->dstar_rhs[start%4]) break;
+        STAT_ADD(dstar_expanded, 1);
+
+        struct cell* cell = cell_of(agent, top.state/4);
+        int dir = top.state%4;
+        dstar_key(agent, top.state, &now);
+        if(dstar_before(&top, &now))
+        {
+            // The agent moved since it was put in, it goes further back
+            agent->dstar_heap[0] = now;
+            dstar_sift_down(agent, 0);
+        }
+        else if(cell->dstar_g[dir]>cell->dstar_rhs[dir])
+        {
+            cell->dstar_g[dir] = cell->dstar_rhs[dir];
+            dstar_remove(agent, 0);
+            n = dstar_preds(agent, top.state, preds);
+            for(i=0; i<n; ++i) dstar_update(agent, preds[i]);
+        }
+        else
+        {
+            cell->dstar_g[dir] = DSTAR_INF;
+            dstar_update(agent, top.state);
+            n = dstar_preds(agent, top.state, preds);
+            for(i=0; i<n; ++i) dstar_update(agent, preds[i]);
+        }
+    }
+}
+
+void dstar_update(Agent agent, int state)
+{
+    struct cell* cell = cell_of(agent, state/4);
+    int dir = state%4;
+    int next;
+    char act;
+
+    dstar_touch(agent, cell, dir);
+    if(state/4!=agent->dstar_goal_id) cell->dstar_rhs[dir] = dstar_best(agent, state, &next, &act);
+    if(cell->dstar_index[dir]!=0) dstar_remove(agent, cell->dstar_index[dir]-1);
+    if(cell->dstar_g[dir]!=cell->dstar_rhs[dir]) dstar_push(agent, state);
+}
+
+// Forward first, so a repaired plan turns as late as the ones of field_path
+int dstar_best(Agent agent, int state, int* next, char* act)
+{
+    int id = state/4;
+    int dir = state%4;
+    int x = cell_x(agent, id)+dir_dx[dir];
+    int y = cell_y(agent, id)+dir_dy[dir];
+    int best = DSTAR_INF;
+    int cost;
+
+    if(dstar_can_enter(agent, x, y) && cell_find(agent, x, y)!=NULL)
+    {
+        cost = dstar_g(agent, cell_id(agent, x, y)*4+dir)+1;
+        if(cost<best)
+        {
+            best = cost;
+            *next = cell_id(agent, x, y)*4+dir;
+            *act = 'f';
+        }
+    }
+    cost = dstar_g(agent, id*4+(dir+1)%4)+1;
+    if(cost<best)
+    {
+        best = cost;
+        *next = id*4+(dir+1)%4;
+        *act = 'r';
+    }
+    cost = dstar_g(agent, id*4+(dir+3)%4)+1;
+    if(cost<best)
+    {
+        best = cost;
+        *next = id*4+(dir+3)%4;
+        *act = 'l';
+    }
+    return MIN(best, DSTAR_INF);
+}
+
+int dstar_preds(Agent agent, int state, int* preds)
+{
+    int id = state/4;
+    int dir = state%4;
+    int x = cell_x(agent, id);
+    int y = cell_y(agent, id);
+    int n = 0;
+
+    preds[n++] = id*4+(dir+3)%4;
+    preds[n++] = id*4+(dir+1)%4;
+    if(dstar_can_enter(agent, x, y) && cell_find(agent, x-dir_dx[dir], y-dir_dy[dir])!=NULL)
+    {
+        preds[n++] = cell_id(agent, x-dir_dx[dir], y-dir_dy[dir])*4+dir;
+    }
+    return n;
+}
+
+int dstar_g(Agent agent, int state)
+{
+    const struct cell* cell = cell_of(agent, state/4);
+    if(cell->dstar_stamp[state%4]!=agent->dstar_id) return DSTAR_INF;
+    return cell->dstar_g[state%4];
+}
+
+void dstar_touch(Agent agent, struct cell* cell, int dir)
+{
+    if(cell->dstar_stamp[dir]==agent->dstar_id) return;
+    cell->dstar_stamp[dir] = agent->dstar_id;
+    cell->dstar_g[dir] = DSTAR_INF;
+    cell->dstar_rhs[dir] = DSTAR_INF;
+    cell->dstar_index[dir] = 0;
+}
+
+bool dstar_can_enter(Agent agent, int x, int y)
+{
+    return (agent->dstar_enter && x==agent->dstar_goal.x && y==agent->dstar_goal.y) || agent->dstar_passable(agent, x, y);
+}
+
+// The search goes from the goal, so the distance to the agent is the heuristic, km makes up for its moves
+void dstar_key(Agent agent, int state, struct dstarKey* key)
+{
+    const struct cell* cell = cell_of(agent, state/4);
+    int m = MIN(cell->dstar_g[state%4], cell->dstar_rhs[state%4]);
+    key->k1 = m+heuristic(agent->status.pos.x, agent->status.pos.y, cell_x(agent, state/4), cell_y(agent, state/4))+agent->dstar_km;
+    key->k2 = m;
+    key->state = state;
+}
+
+bool dstar_before(const struct dstarKey* a, const struct dstarKey* b)
+{
+    return a->k1<b->k1 || (a->k1==b->k1 && a->k2<b->k2);
+}
+
+void dstar_push(Agent agent, int state)
+{
+    dstar_key(agent, state, &agent->dstar_heap[agent->dstar_num]);
+    agent->dstar_num++;
+    dstar_sift_up(agent, agent->dstar_num-1);
+}
+
+void dstar_remove(Agent agent, int i)
+{
+    int state = agent->dstar_heap[i].state;
+    cell_of(agent, state/4)->dstar_index[state%4] = 0;
+    agent->dstar_num--;
+    if(i==agent->dstar_num) return;
+    agent->dstar_heap[i] = agent->dstar_heap[agent->dstar_num];
+    dstar_sift_up(agent, i);
+    state = agent->dstar_heap[i].state;
+    dstar_sift_down(agent, cell_of(agent, state/4)->dstar_index[state%4]-1);
+}
+
+void dstar_sift_up(Agent agent, int i)
+{
+    struct dstarKey key = agent->dstar_heap[i];
+    while(i>0)
+    {
+        int parent = (i-1)/2;
+        if(!dstar_before(&key, &agent->dstar_heap[parent])) break;
+        agent->dstar_heap[i] = agent->dstar_heap[parent];
+        cell_of(agent, agent->dstar_heap[i].state/4)->dstar_index[agent->dstar_heap[i].state%4] = i+1;
+        i = parent;
+    }
+    agent->dstar_heap[i] = key;
+    cell_of(agent, key.state/4)->dstar_index[key.state%4] = i+1;
+}
+
+void dstar_sift_down(Agent agent, int i)
+{
+    struct dstarKey key = agent->dstar_heap[i];
+    while(2*i+1<agent->dstar_num)
+    {
+        int child = 2*i+1;
+        if(child+1<agent->dstar_num && dstar_before(&agent->dstar_heap[child+1], &agent->dstar_heap[child])) child++;
+        if(!dstar_before(&agent->dstar_heap[child], &key)) break;
+        agent->dstar_heap[i] = agent->dstar_heap[child];
+        cell_of(agent, agent->dstar_heap[i].state/4)->dstar_index[agent->dstar_heap[i].state%4] = i+1;
+        i = child;
+    }
+    agent->dstar_heap[i] = key;
+    cell_of(agent, key.state/4)->dstar_index[key.state%4] = i+1;
+}
+
+int plan_remaining(Agent agent)
+{
+    int x = agent->status.pos.x;
+    int y = agent->status.pos.y;
+    int dir = agent->status.direction;
+    int k;
+    for(k=agent->curr_step; k<agent->num_of_steps; ++k)
+    {
+        char act = agent->agent_plan.steps[k];
+        if(act=='f')
+        {
+            x += dir_dx[dir];
+            y += dir_dy[dir];
+            if(!dstar_can_enter(agent, x, y)) return -1;
+        }
+        else if(act=='r') dir = (dir+1)%4;
+        else if(act=='l') dir = (dir+3)%4;
+        else return -1;
+    }
+    if(x!=agent->dstar_goal.x || y!=agent->dstar_goal.y) return -1;
+    return agent->num_of_steps-agent->curr_step;
+}
+
+char* plan_reserve(Plan plan, int n)
+{
+    if(n>plan->cap)
+    {
+        plan->cap = MAX(2*plan->cap, n);
+        plan->steps = realloc(plan->steps, plan->cap);
+        assert(plan->steps!=NULL);
+    }
+    return plan->steps;
+}
+
+// Heuristic function of two points on map
+int heuristic(int srcX, int srcY, int destX, int destY)
+{
+    return abs(srcX-destX)+abs(srcY-destY);
+}
+
+int heuristic_manhattan(Agent agent, int side, int x, int y, int dir, int targetX, int targetY)
+{
+    (void)agent;
+    (void)side;
+    (void)dir;
+    return heuristic(x, y, targetX, targetY);
+}
+
+// The target is one or two of the four ways: facing one of them it takes a turn if there is another, facing away
+// from one takes two. From dest the path to the state walked back faces the other way, so the turns are the same
+int heuristic_turns(Agent agent, int side, int x, int y, int dir, int targetX, int targetY)
+{
+    int across = targetX>x ? EAST : targetX<x ? WEST : -1;
+    int along = targetY>y ? SOUTH : targetY<y ? NORTH : -1;
+    int turns;
+    (void)agent;
+
+    if(side==ASTAR_FROM_DEST) dir = (dir+2)%4;
+    if(across==-1 && along==-1) turns = 0;
+    else if(across==-1 || along==-1)
+    {
+        int way = across==-1 ? along : across;
+        turns = dir==way ? 0 : (dir==(way+2)%4 ? 2 : 1);
+    }
+    else turns = (dir==across || dir==along) ? 1 : 2;
+    return heuristic(x, y, targetX, targetY)+turns;
+}
+
+// For a landmark L the moves between two points p and q are at least d(L,q)-d(L,p) if p can be passed (going through
+// it, L to q is no longer than L to p to q), and d(L,p)-d(L,q) if q can be. A point the landmarks did not get to
+// only has the turns bound
+int heuristic_alt(Agent agent, int side, int x, int y, int dir, int targetX, int targetY)
+{
+    const struct cell* at = cell_peek(agent, x, y);
+    const struct cell* target = cell_peek(agent, targetX, targetY);
+    int ret = heuristic_turns(agent, side, x, y, dir, targetX, targetY);
+    int k;
+
+    if(at->alt_stamp!=agent->alt_id || target->alt_stamp!=agent->alt_id) return ret;
+    bool at_passable = agent->alt_passable(agent, x, y);
+    bool target_passable = agent->alt_passable(agent, targetX, targetY);
+    for(k=0; k<agent->alt_num; ++k)
+    {
+        int d = target->alt_dist[k]-at->alt_dist[k];
+        if(at_passable && d>ret) ret = d;
+        if(target_passable && -d>ret) ret = -d;
+    }
+    return ret;
+}
+
+// The landmarks are kept while the map does not change and the searches are from the same part of it. The first is
+// the point farthest from src, each next one the farthest from the ones before, so they are at the edges of the map
+// and a route towards or away from one gets its real length
+void alt_prepare(Agent agent, Passable passable, int srcX, int srcY)
+{
+    int i, k, num;
+    const struct cell* src = cell_peek(agent, srcX, srcY);
+    if(!agent->alt_dirty && agent->alt_passable==passable && src->alt_stamp==agent->alt_id && passable(agent, srcX, srcY))
+    {
+        return;
+    }
+    STAT_ADD(alt_builds, 1);
+    agent->alt_id++;
+    agent->alt_dirty = false;
+    agent->alt_passable = passable;
+    agent->alt_num = 0;
+
+    // Moves from src first, kept in the distances of the first landmark until it is chosen
+    num = alt_bfs(agent, cell_id(agent, srcX, srcY), -1);
+    for(k=0; k<ALT_LANDMARKS; ++k)
+    {
+        int far = -1;
+        int far_dist = 0;
+        for(i=0; i<num; ++i)
+        {
+            int id = agent->alt_queue[i];
+            const struct cell* cell = cell_of(agent, id);
+            int j, dist = cell->alt_dist[0];
+            if(!passable(agent, cell_x(agent, id), cell_y(agent, id))) continue;
+            for(j=1; j<k; ++j) dist = MIN(dist, cell->alt_dist[j]);
+            if(dist>far_dist)
+            {
+                far = id;
+                far_dist = dist;
+            }
+        }
+        if(far==-1) break;
+        agent->alt_landmarks[k] = far;
+        num = alt_bfs(agent, far, k);
+        agent->alt_num = k+1;
+    }
+}
+
+// BFS of the moves from start into alt_dist[k] of the points passable can pass and the points next to them, which
+// are not gone through. k -1 is the one from src, its moves go to alt_dist[0] and no point is stamped.
+// Return the number of points got to, they are in alt_queue
+int alt_bfs(Agent agent, int start, int k)
+{
+    int head = 0;
+    int tail = 0;
+    int d, visit = ++agent->alt_visit;
+    int slot = MAX(k, 0);
+    struct cell* cell = cell_of(agent, start);
+
+    cell->alt_visit = visit;
+    cell->alt_dist[slot] = 0;
+    if(k>=0) cell->alt_stamp = agent->alt_id;
+    agent->alt_queue[tail++] = start;
+    while(head!=tail)
+    {
+        int id = agent->alt_queue[head++];
+        int x = cell_x(agent, id);
+        int y = cell_y(agent, id);
+        cell = cell_of(agent, id);
+        if(id!=start && !agent->alt_passable(agent, x, y)) continue;
+        for(d=0; d<4; ++d)
+        {
+            struct cell* next = cell_find(agent, x+dir_dx[d], y+dir_dy[d]);
+            if(next==NULL || next->alt_visit==visit) continue;
+            next->alt_visit = visit;
+            next->alt_dist[slot] = cell->alt_dist[slot]+1;
+            if(k>=0) next->alt_stamp = agent->alt_id;
+            agent->alt_queue[tail++] = cell_id(agent, x+dir_dx[d], y+dir_dy[d]);
+        }
+    }
+    STAT_ADD(alt_cells, tail);
+    return tail;
+}
+
+// Get action to send to server
+char interpret_action(Agent agent, Plan plan, int curr_step) {
+
+    // REPLACE THIS CODE WITH AI TO CHOOSE ACTION
+
+    char ch= plan->steps[curr_step];
+
+    if(ch=='F' || ch=='f')
+    {
+        // On the raft the engine keeps sailing and puts no stone
+        bool sailing = cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map=='~';
+        if(agent->status.direction==NORTH)
+        {
+            --agent->status.pos.y;
+        }
+        if(agent->status.direction==EAST)
+        {
+            ++agent->status.pos.x;
+        }
+        if(agent->status.direction==SOUTH)
+        {
+            ++agent->status.pos.y;
+        }
+        if(agent->status.direction==WEST)
+        {
+            --agent->status.pos.x;
+        }
+        if(!sailing && cell_peek(agent, agent->status.pos.x, agent->status.pos.y)->map=='~')
+        {
+            if(agent->status.num_stone>0) 
+            {
+                agent->status.num_stone--;
+                cell_at(agent, agent->status.pos.x, agent->status.pos.y)->map='O';
+                region_update(agent, agent->status.pos.x, agent->status.pos.y);
+                frontier_update(agent, agent->status.pos.x, agent->status.pos.y);
+            }
+            else agent->status.raft=false;
+        }
+        return ch;
+    }
+    else if(ch=='L' || ch=='l')
+    {
+        --agent->status.direction;
+        if(agent->status.direction<NORTH)
+            agent->status.direction=WEST;
+
+        return ch;
+    }
+    else if(ch=='R' || ch=='r')
+    {
+        ++agent->status.direction;
+        if(agent->status.direction>WEST)
+            agent->status.direction=NORTH; 
+
+        return ch;      
     }
     else if(ch=='C' || ch=='c')
     {
-        if(status.direction==NORTH) deleteTree(status.pos.x, status.pos.y-1);
-        else if(status.direction==EAST) deleteTree(status.pos.x+1, status.pos.y);
-        else if(status.direction==SOUTH) deleteTree(status.pos.x, status.pos.y+1);
-        else if(status.direction==WEST) deleteTree(status.pos.x-1, status.pos.y);
-        status.raft=true;
+        // Only a tree gives a raft, one chopped already is just land
+        if(cell_peek(agent, agent->status.pos.x+dir_dx[agent->status.direction], agent->status.pos.y+dir_dy[agent->status.direction])->map!='T') return ch;
+        if(agent->status.direction==NORTH) deleteTree(agent, agent->status.pos.x, agent->status.pos.y-1);
+        else if(agent->status.direction==EAST) deleteTree(agent, agent->status.pos.x+1, agent->status.pos.y);
+        else if(agent->status.direction==SOUTH) deleteTree(agent, agent->status.pos.x, agent->status.pos.y+1);
+        else if(agent->status.direction==WEST) deleteTree(agent, agent->status.pos.x-1, agent->status.pos.y);
+        agent->status.raft=true;
         return ch;
     }
     else if(ch=='U' || ch=='u')
     {
-        if(status.direction==NORTH) deleteDoor(status.pos.x, status.pos.y-1);
-        else if(status.direction==EAST) deleteDoor(status.pos.x+1, status.pos.y);
-        else if(status.direction==SOUTH) deleteDoor(status.pos.x, status.pos.y+1);
-        else if(status.direction==WEST) deleteDoor(status.pos.x-1, status.pos.y);
+        // A plan going back through a door opens it again, nothing to do then
+        if(cell_peek(agent, agent->status.pos.x+dir_dx[agent->status.direction], agent->status.pos.y+dir_dy[agent->status.direction])->map!='-') return ch;
+        if(agent->status.direction==NORTH) deleteDoor(agent, agent->status.pos.x, agent->status.pos.y-1);
+        else if(agent->status.direction==EAST) deleteDoor(agent, agent->status.pos.x+1, agent->status.pos.y);
+        else if(agent->status.direction==SOUTH) deleteDoor(agent, agent->status.pos.x, agent->status.pos.y+1);
+        else if(agent->status.direction==WEST) deleteDoor(agent, agent->status.pos.x-1, agent->status.pos.y);
         return ch;
     }
     else if(ch=='B' || ch=='b')
     {
+        // The engine only blasts a wall, tree or door, and only then uses a dynamite
+        int x = agent->status.pos.x+dir_dx[agent->status.direction];
+        int y = agent->status.pos.y+dir_dy[agent->status.direction];
+        char target = cell_peek(agent, x, y)->map;
+        if(agent->status.num_dynamite==0 || (target!='*' && target!='T' && target!='-')) return ch;
+        agent->status.num_dynamite--;
+        if(target=='T') deleteTree(agent, x, y);
+        else if(target=='-') deleteDoor(agent, x, y);
         return ch;
     }
     else if(ch=='p')
@@ -2054,14 +4201,14 @@ char interpret_action(char* steps, int curr_step) {
 
 // Help function*******************************************************************************************************
 // Print the map that have been seen
-void print_map()
+void print_map(Agent agent)
 {
     int i,j;
-    for(i=status.a.y; i < status.b.y+1; i++ ) 
+    for(i=agent->status.a.y; i < agent->status.b.y+1; i++ ) 
     {
-        for(j=status.a.x; j < status.b.x+1; j++ ) 
+        for(j=agent->status.a.x; j < agent->status.b.x+1; j++ ) 
         {
-            putchar( map[i][j] );
+            putchar( cell_peek(agent, j, i)->map );
         }
         printf("\n");
     }
@@ -2070,9 +4217,9 @@ void print_map()
 
 
 
-void print_tool_list(void)
+void print_tool_list(Agent agent)
 {
-    Tool curr = tool_list;
+    Tool curr = agent->tool_list;
     while(curr!=NULL)
     {
         printf("Tool %c at map[%d][%d]\n", curr->type, curr->y, curr->x);
@@ -2082,30 +4229,159 @@ void print_tool_list(void)
 
 
 
-void print_accessible(void)
+void print_accessible(Agent agent)
 {
     int i,j;
-    for(i=status.a.y; i < status.b.y+1; i++ ) 
+    for(i=agent->status.a.y; i < agent->status.b.y+1; i++ ) 
     {
-        for(j=status.a.x; j < status.b.x+1; j++ ) 
+        for(j=agent->status.a.x; j < agent->status.b.x+1; j++ ) 
         {
-            if(accessable[i][j]) putchar('+');
+            if(accessable(agent, cell_peek(agent, j, i))) putchar('+');
             else putchar('-');
         }
         printf("\n");
     }
 }
 
-void print_accessible_2(void)
+unsigned long long stats_clock(void)
 {
-    int i,j;
-    for(i=status.a.y; i < status.b.y+1; i++ ) 
+#if defined(AGENT_STATS) && (defined(__x86_64__) || defined(__i386__))
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1000000000ULL+now.tv_nsec;
+#endif
+}
+
+void agent_stats_dump(Agent agent, FILE* out, const char* name)
+{
+#ifdef AGENT_STATS
+    static const char* branch_name[BRANCH_NUM] = {
+        "go_on_lake", "plan_win", "go_home", "tool", "open_door", "go_door", "explore", "chop_tree", "go_tree",
+        "land_for_tree", "land_for_home", "land_for_door", "stone_lake", "raft_lake", "sea_crossing", "go_sea",
+        "stone_treasure", "stone_any_lake", "dynamite", "plan_explore", "none" };
+    int i;
+
+    fprintf(out, "{\"map\": \"%s\", \"decisions\": %ld, \"branch\": {", name ? name : "", agent->stats.decisions);
+    for(i=0; i<BRANCH_NUM; ++i)
     {
-        for(j=status.a.x; j < status.b.x+1; j++ ) 
+        fprintf(out, "%s\"%s\": %ld", i ? ", " : "", branch_name[i], agent->stats.branch[i]);
+    }
+    fprintf(out, "}, \"reachable_calls\": %ld, \"region_rebuilds\": %ld", agent->stats.reachable_calls, agent->stats.region_rebuilds);
+    fprintf(out, ", \"flood_fills\": %ld, \"flood_cells\": %ld", agent->stats.flood_fills, agent->stats.flood_cells);
+    fprintf(out, ", \"field_builds\": %ld, \"field_states\": %ld", agent->stats.field_builds, agent->stats.field_states);
+    fprintf(out, ", \"astar_searches\": %ld, \"astar_pushed\": %ld, \"astar_popped\": %ld, \"astar_reinserted\": %ld",
+            agent->stats.astar_searches, agent->stats.astar_pushed, agent->stats.astar_popped, agent->stats.astar_reinserted);
+    fprintf(out, ", \"astar_bidir_searches\": %ld, \"astar_bidir_expanded\": %ld",
+            agent->stats.astar_bidir_searches, agent->stats.astar_bidir_expanded);
+    fprintf(out, ", \"alt_builds\": %ld, \"alt_cells\": %ld", agent->stats.alt_builds, agent->stats.alt_cells);
+    fprintf(out, ", \"stone_builds\": %ld, \"stone_cells\": %ld", agent->stats.stone_builds, agent->stats.stone_cells);
+    fprintf(out, ", \"plan_searches\": %ld, \"plan_labels\": %ld, \"plan_expanded\": %ld",
+            agent->stats.plan_searches, agent->stats.plan_labels, agent->stats.plan_expanded);
+    fprintf(out, ", \"dstar_checks\": %ld, \"dstar_expanded\": %ld, \"plans_repaired\": %ld, \"plans_dropped\": %ld",
+            agent->stats.dstar_checks, agent->stats.dstar_expanded, agent->stats.plans_repaired, agent->stats.plans_dropped);
+    fprintf(out, ", \"cycles\": {\"find_a_path\": %llu, \"astar\": %llu, \"flood\": %llu, \"field\": %llu, \"stone\": %llu, \"plan\": %llu, \"dstar\": %llu}}\n",
+            agent->stats.find_a_path_cycles, agent->stats.astar_cycles, agent->stats.flood_cycles, agent->stats.field_cycles, agent->stats.stone_cycles,
+            agent->stats.plan_cycles, agent->stats.dstar_cycles);
+    fflush(out);
+#endif
+}
+
+void agent_astar_compare(Agent agent, int routes, FILE* out, const char* name)
+{
+#ifdef AGENT_STATS
+    static const char* mode_name[2] = { "forward", "bidirectional" };
+    static const char* heuristic_name[3] = { "manhattan", "turns", "alt" };
+    static const Heuristic heuristics[3] = { heuristic_manhattan, heuristic_turns, heuristic_alt };
+    struct stats saved = agent->stats;
+    struct plan scratch = { NULL, 0 };
+    long expanded[2][3] = { { 0 } };
+    unsigned long long cycles[2][3] = { { 0 } };
+    unsigned long long alt_cycles = 0;
+    long length = 0;
+    long alt_cells = 0;
+    unsigned int seed = 1;
+    int* points = malloc(agent->chunks_num*CHUNK_CELLS*sizeof(int));
+    int num = 0, found = 0;
+    int c, k, r, mode, h;
+
+    // Every point which can be walked or sailed on, the routes are between two of them in the same region
+    for(c=0; c<agent->chunks_num; ++c)
+    {
+        for(k=0; k<CHUNK_CELLS; ++k)
         {
-            if(accessable_2[i][j]) putchar('+');
-            else putchar('-');
+            int id = c*CHUNK_CELLS+k;
+            if(passable_land(agent, cell_x(agent, id), cell_y(agent, id))
+               || passable_sea(agent, cell_x(agent, id), cell_y(agent, id))) points[num++] = id;
         }
-        printf("\n");
     }
-}
\ No newline at end of file
+    for(r=0; r<routes && num>1; ++r)
+    {
+        // The same routes every run, whatever rand() is used for
+        seed = seed*1103515245+12345;
+        int src = points[(seed>>8)%num];
+        seed = seed*1103515245+12345;
+        int dest = points[(seed>>8)%num];
+        int direction = (seed>>4)%4;
+        int srcX = cell_x(agent, src), srcY = cell_y(agent, src);
+        int destX = cell_x(agent, dest), destY = cell_y(agent, dest);
+        if(src==dest || region_find(agent, srcX, srcY)!=region_find(agent, destX, destY)) continue;
+        Passable passable = passable_sea(agent, srcX, srcY) ? passable_sea : passable_land;
+
+        int cost[2][3];
+        for(h=0; h<3; ++h)
+        {
+            if(heuristics[h]==heuristic_alt)
+            {
+                long before = agent->stats.alt_cells;
+                unsigned long long start = stats_clock();
+                alt_prepare(agent, passable, srcX, srcY);
+                alt_cycles += stats_clock()-start;
+                alt_cells += agent->stats.alt_cells-before;
+            }
+            for(mode=ASTAR_FORWARD; mode<=ASTAR_BIDIRECTIONAL; ++mode)
+            {
+                long before = agent->stats.astar_popped;
+                unsigned long long start = stats_clock();
+                if(mode==ASTAR_FORWARD)
+                {
+                    cost[mode][h] = astar_forward(agent, srcX, srcY, direction, destX, destY, passable, heuristics[h], &scratch);
+                }
+                else
+                {
+                    cost[mode][h] = astar_bidirectional(agent, srcX, srcY, direction, destX, destY, passable, heuristics[h], &scratch);
+                }
+                cycles[mode][h] += stats_clock()-start;
+                expanded[mode][h] += agent->stats.astar_popped-before;
+                assert(cost[mode][h]==cost[ASTAR_FORWARD][0]);
+            }
+        }
+        if(cost[ASTAR_FORWARD][0]==-1) continue;
+        found++;
+        length += cost[ASTAR_FORWARD][0];
+    }
+    free(points);
+    free(scratch.steps);
+    agent->stats = saved;
+
+    fprintf(out, "{\"map\": \"%s\", \"astar_routes\": %d, \"astar_length\": %ld, \"alt_cells\": %ld, \"alt_cycles\": %llu",
+            name ? name : "", found, length, alt_cells, alt_cycles);
+    fprintf(out, ", \"expanded\": {");
+    for(mode=ASTAR_FORWARD; mode<=ASTAR_BIDIRECTIONAL; ++mode)
+    {
+        fprintf(out, "%s\"%s\": {", mode ? ", " : "", mode_name[mode]);
+        for(h=0; h<3; ++h) fprintf(out, "%s\"%s\": %ld", h ? ", " : "", heuristic_name[h], expanded[mode][h]);
+        fprintf(out, "}");
+    }
+    fprintf(out, "}, \"cycles\": {");
+    for(mode=ASTAR_FORWARD; mode<=ASTAR_BIDIRECTIONAL; ++mode)
+    {
+        fprintf(out, "%s\"%s\": {", mode ? ", " : "", mode_name[mode]);
+        for(h=0; h<3; ++h) fprintf(out, "%s\"%s\": %llu", h ? ", " : "", heuristic_name[h], cycles[mode][h]);
+        fprintf(out, "}");
+    }
+    fprintf(out, "}}\n");
+    fflush(out);
+#endif
+}
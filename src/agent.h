@@ -0,0 +1,46 @@
+/*********************************************
+ *  agent.h
+ *  Entry points of the agent, used by main and by the in-process engine
+*/
+
+#include <stdio.h>
+
+// All the state of one agent, games played with different agents don't share anything,
+// so each can be on its own thread
+typedef struct agent* Agent;
+
+// A new agent, NULL if out of memory, agent_init it before the first game
+Agent agent_create(void);
+
+// Free the agent and everything it holds
+void agent_free(Agent agent);
+
+// Start a new game, the agent forgets everything it knew
+void agent_init(Agent agent);
+
+// Take the 5-by-5 view the engine sent, return the next action, or 0 if the agent has nothing to do
+char agent_act(Agent agent, char view[5][5]);
+
+// The three steps of agent_act, for engines that take more than one action at a time:
+// take a view, get the actions left in the plan (making a new plan if none left, 0 if it has nothing to do),
+// and take the next action of them
+void agent_observe(Agent agent, char view[5][5]);
+int agent_pending(Agent agent, const char** actions);
+char agent_step(Agent agent);
+
+// Take the next n actions of the plan, views[i] is what the engine showed after action i
+void agent_observe_batch(Agent agent, char views[][5][5], int n);
+
+// Let A* search with the ALT heuristic (on) instead of the distance and turns. Its landmarks are built again on the
+// first search after the map changed, so it pays where many searches are made on one map
+void agent_use_alt(Agent agent, int on);
+
+// Wall time spent in find_a_path since agent_init, in nanoseconds
+long long agent_plan_ns(Agent agent);
+
+// Write the planner counters of this game as one JSON line, nothing unless built with -DAGENT_STATS
+void agent_stats_dump(Agent agent, FILE* out, const char* name);
+
+// Search routes between random points of the map the agent knows now with each way A* can search, and write the
+// states each expanded as one JSON line, nothing unless built with -DAGENT_STATS
+void agent_astar_compare(Agent agent, int routes, FILE* out, const char* name);
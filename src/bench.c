@@ -0,0 +1,257 @@
+/*********************************************
+ *  bench.c
+ *  Benchmark of the agent on map files with the in-process engine.
+ *  Usage: benchmark [-n games] [-m maxmoves] [-t percent] [-o report] [-b baseline] map ...
+ *
+ *  Each map is played in its own child process, so its peak RSS is its own. A line per map is written to the report:
+ *      map result moves wall_us plan_us rss_kb
+ *  wall_us and plan_us (the part spent in find_a_path) are the best of the games, the agent plays the same game each
+ *  time so the best is the least noisy. With -b, every map also in the baseline is compared to it and the exit status
+ *  is 1 if a map is not won any more or takes more moves to win. The games are the same on every machine, the times
+ *  and RSS are not, so they are only compared with -t, and a regression then if they grew more than that percent.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "engine.h"
+#include "agent.h"
+
+#define BENCH_MAX_MAPS 1024
+
+// Time differences smaller than this are noise, never a regression
+#define BENCH_MIN_US 500
+
+struct benchResult
+{
+    char map[256];
+    char result[16];
+    long moves;
+    long wall_us;
+    long plan_us;
+    long rss_kb;
+};
+
+typedef struct benchResult* BenchResult;
+
+static const char* result_name[] = { "won", "lost", "stuck", "exceeded" };
+
+// Play the map games times in this process, best time of them
+static int bench_map(const char* path, int games, int maxmoves, BenchResult out)
+{
+    struct world world;
+    struct game game = { 0 };
+    struct timespec begin, end;
+    int g, result = GAME_EXCEEDED, moves = 0;
+    Agent agent;
+
+    if(!world_load(&world, path)) return 0;
+    agent = agent_create();
+    if(agent==NULL)
+    {
+        world_free(&world);
+        return 0;
+    }
+
+    out->wall_us = -1;
+    for(g=0; g<games; g++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        result = game_play(&game, &world, agent, maxmoves, &moves);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        long wall = (end.tv_sec-begin.tv_sec)*1000000L+(end.tv_nsec-begin.tv_nsec)/1000;
+        long plan = agent_plan_ns(agent)/1000;
+        if(out->wall_us==-1 || wall<out->wall_us) out->wall_us = wall;
+        if(g==0 || plan<out->plan_us) out->plan_us = plan;
+    }
+    strcpy(out->result, result_name[result]);
+    out->moves = moves;
+
+    game_free(&game);
+    agent_free(agent);
+    world_free(&world);
+    return 1;
+}
+
+// Run bench_map in a child, which sends back the result through a pipe, and take its peak RSS
+static int bench_child(const char* path, int games, int maxmoves, BenchResult out)
+{
+    struct rusage usage;
+    int fd[2], status;
+    pid_t pid;
+
+    if(pipe(fd)<0) return 0;
+    pid = fork();
+    if(pid<0) return 0;
+    if(pid==0)
+    {
+        close(fd[0]);
+        int ok = bench_map(path, games, maxmoves, out);
+        if(ok && write(fd[1], out, sizeof(*out))!=sizeof(*out)) ok = 0;
+        _exit(ok ? 0 : 1);
+    }
+    close(fd[1]);
+    int got = read(fd[0], out, sizeof(*out))==sizeof(*out);
+    close(fd[0]);
+    if(wait4(pid, &status, 0, &usage)<0 || !WIFEXITED(status) || WEXITSTATUS(status)!=0) return 0;
+    out->rss_kb = usage.ru_maxrss;
+    return got;
+}
+
+// Read a report written before, return the number of maps in it
+static int read_report(const char* path, struct benchResult* results, int max)
+{
+    char line[512];
+    int num = 0;
+    FILE* in = fopen(path, "r");
+    if(in==NULL) return -1;
+    while(num<max && fgets(line, sizeof(line), in)!=NULL)
+    {
+        BenchResult r = &results[num];
+        if(line[0]=='#') continue;
+        if(sscanf(line, "%255s %15s %ld %ld %ld %ld", r->map, r->result, &r->moves, &r->wall_us, &r->plan_us,
+                  &r->rss_kb)==6)
+        {
+            num++;
+        }
+    }
+    fclose(in);
+    return num;
+}
+
+// Whether value grew past base by more than percent, times are allowed BENCH_MIN_US of noise
+static int grew(long value, long base, int percent, long floor)
+{
+    return value-base>floor && value*100>base*(100+percent);
+}
+
+// Compare one map to the baseline, print every change and return the number of regressions. A change of result is
+// one line of its own, the moves are only compared when both games were won, the rest only if percent is not -1
+static int compare(BenchResult now, BenchResult base, int percent)
+{
+    int bad = 0;
+    int won = strcmp(now->result, "won")==0;
+    int was_won = strcmp(base->result, "won")==0;
+    if(strcmp(now->result, base->result)!=0)
+    {
+        printf("%s %s: %s, was %s\n", was_won ? "REGRESSION" : won ? "IMPROVED" : "CHANGED", now->map, now->result,
+               base->result);
+        if(was_won) bad++;
+    }
+    else if(won && now->moves!=base->moves)
+    {
+        printf("%s %s: moves %ld, was %ld\n", now->moves>base->moves ? "REGRESSION" : "IMPROVED", now->map,
+               now->moves, base->moves);
+        if(now->moves>base->moves) bad++;
+    }
+    if(percent<0) return bad;
+    if(grew(now->wall_us, base->wall_us, percent, BENCH_MIN_US))
+    {
+        printf("REGRESSION %s: wall %ld us, was %ld us\n", now->map, now->wall_us, base->wall_us);
+        bad++;
+    }
+    if(grew(now->plan_us, base->plan_us, percent, BENCH_MIN_US))
+    {
+        printf("REGRESSION %s: find_a_path %ld us, was %ld us\n", now->map, now->plan_us, base->plan_us);
+        bad++;
+    }
+    if(grew(now->rss_kb, base->rss_kb, percent, 0))
+    {
+        printf("REGRESSION %s: peak RSS %ld kB, was %ld kB\n", now->map, now->rss_kb, base->rss_kb);
+        bad++;
+    }
+    return bad;
+}
+
+static void print_usage(const char* name)
+{
+    printf("Usage: %s [-n games] [-m maxmoves] [-t percent] [-o report] [-b baseline] map ...\n", name);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct benchResult results[BENCH_MAX_MAPS];
+    static struct benchResult baseline[BENCH_MAX_MAPS];
+    const char* report = "bench_report.txt";
+    const char* baseline_path = NULL;
+    int games = 10;
+    int maxmoves = 10000;
+    int percent = -1;
+    int num = 0, num_base = 0, bad = 0;
+    int i, k;
+    FILE* out;
+
+    k = 1;
+    while(k<argc && argv[k][0]=='-')
+    {
+        if(strcmp(argv[k], "-n")==0 && k+1<argc) games = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-m")==0 && k+1<argc) maxmoves = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-t")==0 && k+1<argc) percent = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-o")==0 && k+1<argc) report = argv[++k];
+        else if(strcmp(argv[k], "-b")==0 && k+1<argc) baseline_path = argv[++k];
+        else print_usage(argv[0]);
+        k++;
+    }
+    if(k>=argc || games<1) print_usage(argv[0]);
+
+    printf("%-24s %-8s %6s %10s %10s %8s\n", "map", "result", "moves", "wall_us", "plan_us", "rss_kb");
+    for(; k<argc && num<BENCH_MAX_MAPS; k++)
+    {
+        BenchResult r = &results[num];
+        if(!bench_child(argv[k], games, maxmoves, r))
+        {
+            printf("%s: can not play map\n", argv[k]);
+            bad++;
+            continue;
+        }
+        snprintf(r->map, sizeof(r->map), "%s", argv[k]);
+        printf("%-24s %-8s %6ld %10ld %10ld %8ld\n", r->map, r->result, r->moves, r->wall_us, r->plan_us, r->rss_kb);
+        num++;
+    }
+
+    out = fopen(report, "w");
+    if(out==NULL)
+    {
+        perror(report);
+        return 2;
+    }
+    fprintf(out, "# map result moves wall_us plan_us rss_kb\n");
+    for(i=0; i<num; i++)
+    {
+        BenchResult r = &results[i];
+        fprintf(out, "%s %s %ld %ld %ld %ld\n", r->map, r->result, r->moves, r->wall_us, r->plan_us, r->rss_kb);
+    }
+    fclose(out);
+
+    if(baseline_path!=NULL)
+    {
+        num_base = read_report(baseline_path, baseline, BENCH_MAX_MAPS);
+        if(num_base<0)
+        {
+            printf("no baseline %s, nothing compared\n", baseline_path);
+            num_base = 0;
+        }
+        for(i=0; i<num; i++)
+        {
+            for(k=0; k<num_base; k++)
+            {
+                if(strcmp(results[i].map, baseline[k].map)==0)
+                {
+                    bad += compare(&results[i], &baseline[k], percent);
+                    break;
+                }
+            }
+        }
+        if(percent<0) printf("%d regression(s) against %s\n", bad, baseline_path);
+        else printf("%d regression(s) against %s, times and RSS at %d%%\n", bad, baseline_path, percent);
+    }
+
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,316 @@
+/*********************************************
+ *  engine.c
+ *  C port of Step.java, the Game Engine for Text-Based Adventure Game
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "engine.h"
+#include "agent.h"
+
+// Cell of the game map at row r, column c
+#define CELL(game, r, c) ((game)->cells[(game)->world->row_start[r]+(c)])
+
+int world_load(World world, const char* path)
+{
+    struct stat st;
+    int fd, r, c;
+    size_t i;
+
+    fd = open(path, O_RDONLY);
+    if(fd<0) return 0;
+    if(fstat(fd, &st)<0 || st.st_size==0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    world->name = path;
+    world->size = st.st_size;
+    world->text = mmap(NULL, world->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(world->text==MAP_FAILED) return 0;
+
+    // Rows until the end of file or the first empty line, as Step.java reads them
+    world->nrows = 0;
+    world->irow = -1;
+    i = 0;
+    while(i<world->size && world->text[i]!='\n' && world->nrows<WORLD_MAX_ROWS)
+    {
+        r = world->nrows++;
+        world->row_start[r] = i;
+        while(i<world->size && world->text[i]!='\n') ++i;
+        world->row_len[r] = i-world->row_start[r];
+        ++i;
+
+        for(c=0; c<world->row_len[r]; ++c)
+        {
+            int dirn = -1;
+            switch(world->text[world->row_start[r]+c])
+            {
+                case '^': dirn = STEP_NORTH; break;
+                case '>': dirn = STEP_EAST;  break;
+                case 'v': dirn = STEP_SOUTH; break;
+                case '<': dirn = STEP_WEST;  break;
+            }
+            if(dirn!=-1)
+            {
+                world->irow = r;
+                world->icol = c;
+                world->idirn = dirn;
+            }
+        }
+    }
+
+    if(world->irow==-1)
+    {
+        world_free(world);
+        return 0;
+    }
+    return 1;
+}
+
+void world_free(World world)
+{
+    munmap(world->text, world->size);
+    world->text = NULL;
+}
+
+void game_start(Game game, World world)
+{
+    if(game->cells_size<world->size)
+    {
+        free(game->cells);
+        game->cells = malloc(world->size);
+        game->cells_size = world->size;
+    }
+    memcpy(game->cells, world->text, world->size);
+
+    game->world = world;
+    game->row = world->irow;
+    game->col = world->icol;
+    game->dirn = world->idirn;
+    game->have_axe = 0;
+    game->have_key = 0;
+    game->have_treasure = 0;
+    game->have_raft = 0;
+    game->on_raft = 0;
+    game->off_map = 0;
+    game->num_dynamites_held = 0;
+    game->num_stones_held = 0;
+    game->game_won = 0;
+    game->game_lost = 0;
+}
+
+void game_free(Game game)
+{
+    free(game->cells);
+    game->cells = NULL;
+    game->cells_size = 0;
+}
+
+void game_view(Game game, char view[5][5])
+{
+    World world = game->world;
+    int i, j, r=0, c=0;
+
+    for(i=-2; i<=2; i++)
+    {
+        for(j=-2; j<=2; j++)
+        {
+            switch(game->dirn)
+            {
+                case STEP_NORTH: r = game->row+i; c = game->col+j; break;
+                case STEP_SOUTH: r = game->row-i; c = game->col-j; break;
+                case STEP_EAST:  r = game->row+j; c = game->col-i; break;
+                case STEP_WEST:  r = game->row-j; c = game->col+i; break;
+            }
+            if(r>=0 && r<world->nrows && c>=0 && c<world->row_len[r])
+            {
+                view[2+i][2+j] = CELL(game, r, c);
+            }
+            else
+            {
+                view[2+i][2+j] = '.';
+            }
+        }
+    }
+}
+
+int game_apply(Game game, char action)
+{
+    World world = game->world;
+    int d_row, d_col;
+    int new_row, new_col;
+    char ch;
+
+    if(action=='L' || action=='l')
+    {
+        game->dirn = (game->dirn+1)%4;
+        return 1;
+    }
+    if(action=='R' || action=='r')
+    {
+        game->dirn = (game->dirn+3)%4;
+        return 1;
+    }
+
+    d_row = 0;
+    d_col = 0;
+    switch(game->dirn)
+    {
+        case STEP_NORTH: d_row = -1; break;
+        case STEP_SOUTH: d_row =  1; break;
+        case STEP_EAST:  d_col =  1; break;
+        case STEP_WEST:  d_col = -1; break;
+    }
+    new_row = game->row+d_row;
+    new_col = game->col+d_col;
+
+    // Walking off the map loses the game
+    if(new_row<0 || new_row>=world->nrows || new_col<0 || new_col>=world->row_len[new_row])
+    {
+        if(action=='F' || action=='f')
+        {
+            if(!game->off_map)
+            {
+                CELL(game, game->row, game->col) = '~';
+                game->off_map = 1;
+            }
+            game->row = new_row;
+            game->col = new_col;
+            game->game_lost = 1;
+            return 1;
+        }
+        return 0;
+    }
+
+    ch = CELL(game, new_row, new_col);
+
+    switch(action)
+    {
+        case 'F': case 'f':
+            // Can't move into an obstacle
+            if(ch=='*' || ch=='T' || ch=='-') return 0;
+            if(!game->off_map && CELL(game, game->row, game->col)!='O') CELL(game, game->row, game->col) = ' ';
+
+            switch(ch)
+            {
+                case '~':
+                    if(game->on_raft)
+                    {
+                        if(!game->off_map) CELL(game, game->row, game->col) = '~';
+                    }
+                    else if(game->num_stones_held>0)
+                    {
+                        game->num_stones_held--;
+                        if(!game->off_map) CELL(game, new_row, new_col) = 'O';
+                    }
+                    else if(game->have_raft)
+                    {
+                        game->on_raft = 1;
+                        if(!game->off_map && CELL(game, game->row, game->col)!='O') CELL(game, game->row, game->col) = ' ';
+                    }
+                    else
+                    {
+                        game->game_lost = 1;
+                    }
+                    break;
+                case ' ': case 'a': case 'k': case '$': case 'd': case 'o': case 'O':
+                    if(game->on_raft && !game->off_map)
+                    {
+                        CELL(game, game->row, game->col) = '~';
+                        game->on_raft = 0;
+                        game->have_raft = 0;
+                    }
+                    break;
+            }
+            game->row = new_row;
+            game->col = new_col;
+            switch(ch)
+            {
+                case 'a': game->have_axe = 1; break;
+                case 'k': game->have_key = 1; break;
+                case '$': game->have_treasure = 1; break;
+                case 'd': game->num_dynamites_held++; break;
+                case 'o': game->num_stones_held++; break;
+            }
+            if(game->have_treasure && game->row==world->irow && game->col==world->icol)
+            {
+                game->game_won = 1;
+            }
+            if(!game->off_map && CELL(game, game->row, game->col)!='O')
+            {
+                CELL(game, game->row, game->col) = ' ';
+            }
+            game->off_map = 0;
+            return 1;
+
+        case 'C': case 'c':
+            if(ch=='T' && game->have_axe)
+            {
+                CELL(game, new_row, new_col) = ' ';
+                game->have_raft = 1;
+                return 1;
+            }
+            break;
+
+        case 'U': case 'u':
+            if(ch=='-' && game->have_key)
+            {
+                CELL(game, new_row, new_col) = ' ';
+                return 1;
+            }
+            break;
+
+        case 'B': case 'b':
+            if(game->num_dynamites_held>0 && (ch=='*' || ch=='T' || ch=='-'))
+            {
+                CELL(game, new_row, new_col) = ' ';
+                game->num_dynamites_held--;
+                return 1;
+            }
+            break;
+    }
+    return 0;
+}
+
+int game_play(Game game, World world, Agent agent, int maxmoves, int* moves)
+{
+    char view[5][5];
+    char action;
+    int m;
+
+    game_start(game, world);
+    agent_init(agent);
+
+    for(m=1; m<=maxmoves; m++)
+    {
+        game_view(game, view);
+        action = agent_act(agent, view);
+        if(action==0)
+        {
+            *moves = m-1;
+            return GAME_STUCK;
+        }
+        game_apply(game, action);
+        if(game->game_won)
+        {
+            *moves = m;
+            return GAME_WON;
+        }
+        if(game->game_lost)
+        {
+            *moves = m;
+            return GAME_LOST;
+        }
+    }
+    *moves = maxmoves;
+    return GAME_EXCEEDED;
+}
@@ -0,0 +1,84 @@
+/*********************************************
+ *  engine.h
+ *  C port of Step.java, the Game Engine for Text-Based Adventure Game
+ *  Plays the game in the same process as the agent, no socket needed
+*/
+
+#include <stddef.h>
+
+// Directions as Step.java numbers them, not as the agent does
+#define STEP_EAST   0
+#define STEP_NORTH  1
+#define STEP_WEST   2
+#define STEP_SOUTH  3
+
+#define WORLD_MAX_ROWS 1024
+
+// How a game ended
+#define GAME_WON      0
+#define GAME_LOST     1
+#define GAME_STUCK    2
+#define GAME_EXCEEDED 3
+
+// A map file, loaded once and shared by every game played on it.
+// Row r is text[row_start[r]] to text[row_start[r]+row_len[r]-1]
+struct world
+{
+    const char* name;
+    char* text;
+    size_t size;
+    int nrows;
+    int row_start[WORLD_MAX_ROWS];
+    int row_len[WORLD_MAX_ROWS];
+    int irow;
+    int icol;
+    int idirn;
+};
+
+typedef struct world* World;
+
+// One game on a world, cells is its own copy of the map as the game changes it
+struct game
+{
+    World world;
+    char* cells;
+    size_t cells_size;
+    int row;
+    int col;
+    int dirn;
+    int have_axe;
+    int have_key;
+    int have_treasure;
+    int have_raft;
+    int on_raft;
+    int off_map;
+    int num_dynamites_held;
+    int num_stones_held;
+    int game_won;
+    int game_lost;
+};
+
+typedef struct game* Game;
+
+// Memory map a map file, return 0 if it can not be read or has no agent
+int world_load(World world, const char* path);
+
+// Unmap the map file
+void world_free(World world);
+
+// Start a new game on the world, the cells are only allocated again when a bigger map comes
+void game_start(Game game, World world);
+
+// Free the cells of the game
+void game_free(Game game);
+
+// The 5-by-5 view of the agent, rotated as it is facing, '.' outside the map
+void game_view(Game game, char view[5][5]);
+
+// Apply one action as Step.java does, return whether it did anything
+int game_apply(Game game, char action);
+
+// Play one game from the start with the agent in this process (as Step.java does without -p),
+// return how it ended and the number of moves in moves. The agent is an Agent of agent.h
+struct agent;
+int game_play(Game game, World world, struct agent* agent, int maxmoves, int* moves);
@@ -5,4 +5,114 @@
  *  UNSW Session 1, 2017
 */
 
+/* bytes of a view on the wire, the 5x5 view without the agent in the middle */
+#define PIPE_VIEW_SIZE 24
+
+/* most actions sent at once in batch mode, the count is one byte */
+#define PIPE_BATCH_MAX 255
+
+/* what has come from the engine and not been read yet, a whole batch of views fits */
+#define PIPE_BUF_SIZE 16384
+
+/* delta views: an agent started with -d asks for them with PIPE_DELTA_ASK before its first action, no action or
+   batch count is 0. The engine answers right after the first view, PIPE_DELTA_YES if it was started with -d and
+   the views after that one are deltas, else PIPE_DELTA_NO. The engine never sends either to an agent that did not
+   ask, so an agent without -d plays it as any other engine. Each delta view starts with how to get it from the
+   last one:
+     PIPE_DELTA_KEY       24 bytes follow, the whole view
+     PIPE_DELTA_SAME      the last view
+     PIPE_DELTA_FORWARD   the last view one row closer, the 5 bytes of the new row 0 follow
+     PIPE_DELTA_LEFT      the last view turned left, new[a][b] = last[4-b][a]
+     PIPE_DELTA_RIGHT     the last view turned right, new[a][b] = last[b][4-a]
+   and but for a keyframe, a count byte and (cell a*5+b, char) pairs for the cells that are not as predicted */
+#define PIPE_DELTA_ASK     0
+#define PIPE_DELTA_YES     'D'
+#define PIPE_DELTA_NO      'N'
+#define PIPE_DELTA_KEY     'K'
+#define PIPE_DELTA_SAME    '='
+#define PIPE_DELTA_FORWARD 'F'
+#define PIPE_DELTA_LEFT    'L'
+#define PIPE_DELTA_RIGHT   'R'
+
+#include <stdio.h>
+#include <time.h>
+
+/* what the game loop cost, wait is from sending an action to having the whole next view */
+struct pipe_stats {
+  long moves;
+  long batches;
+  long bytes_in;
+  long recv_calls;
+  long short_reads;
+  long send_calls;
+  long long wait_ns;
+  long long max_wait_ns;
+};
+
+/* the connection to the Game Engine, in and out are the same socket except for stdin/stdout */
+struct transport {
+  int in;
+  int out;
+  int sock;     /* use recv/send, else read/write */
+  int batch;    /* batch protocol, see pipe_send_actions() */
+  int asked;    /* sent PIPE_DELTA_ASK, the answer comes after the first view */
+  int delta;    /* delta views, see PIPE_DELTA_ASK */
+  char prev[25];  /* last view, for delta views */
+  char buf[PIPE_BUF_SIZE];
+  int len;
+  int pos;
+  struct pipe_stats stats;  /* of this connection only, see pipe_stats_print() */
+  struct timespec sent_at;  /* time the last action was sent, the wait for the next view starts there */
+};
+
+typedef struct transport *Transport;
+
+/* connect over TCP, IPv4 or IPv6 */
 int tcpopen(char *host, int port);
+
+/* connect to a Unix domain socket at path */
+int unixopen(char *path);
+
+/* use a connected socket, e.g. one end of a socketpair the agent was started with */
+void transport_socket(Transport link, int sd);
+
+/* use fds already open, 0 and 1 for stdin/stdout */
+void transport_fds(Transport link, int in, int out);
+
+/* connect as the command line says, 0 if it makes no sense:
+     -p port [-h host]   TCP, host is localhost by default
+     -u path             Unix domain socket
+     -f fd               socket (or other fd) inherited from the parent, e.g. from socketpair
+     -s                  stdin/stdout
+   and -b for the batch protocol, -d to ask for delta views */
+int transport_open(Transport link, int argc, char *argv[]);
+
+/* ask for delta views, the answer is read with the first view */
+void transport_handshake(Transport link);
+
+/* read one whole view into view (middle left alone), 0 if the connection is closed */
+int pipe_read_view(Transport link, char view[5][5]);
+
+/* send one action, 0 if it could not be sent (errno EAGAIN if the fd is O_NONBLOCK and full, try again later) */
+int pipe_send_action(Transport link, char action);
+
+/* batch protocol (engine started with -b): send a count byte and up to PIPE_BATCH_MAX actions in one write,
+   the engine takes them until one fails or the game ends and answers a count byte and a view after each action
+   it took. Return 0 if it could not be sent */
+int pipe_send_actions(Transport link, const char *actions, int n);
+
+/* read the answer to pipe_send_actions(), return the number of views, 0 if the connection is closed */
+int pipe_read_views(Transport link, char views[][5][5]);
+
+/* for many links in one thread (fd made O_NONBLOCK): take whatever has come without waiting. Return the bytes read,
+   0 if the connection is closed, -1 with errno EAGAIN if nothing has come */
+int pipe_recv(Transport link);
+
+/* whether a whole view has come, then pipe_read_view() does not wait */
+int pipe_view_ready(Transport link);
+
+/* counters of link since it was opened */
+struct pipe_stats *pipe_stats(Transport link);
+
+/* write the counters of link as one JSON line */
+void pipe_stats_print(Transport link, FILE *out);
@@ -0,0 +1,378 @@
+/*********************************************
+ *  server.c
+ *  Plays many games in one process, one Agent for each connection to a Game Engine.
+ *  Usage: agent_server [-w workers] [-h host] [-d] -p port[-last] | -u path ...
+ *
+ *  Each -p connects to a Step engine started with -p port (a range connects to every port in it), each -u to a Unix
+ *  socket. One thread waits on all the connections with epoll and only reads a view once it has all come, the planning
+ *  is done by a pool of workers, so a slow find_a_path in one game never holds up the others. When an engine closes
+ *  its connection, or the agent has no action left to send, the game is over: a line is written for it and the
+ *  server ends with the last one.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "pipe.h"
+#include "agent.h"
+
+#define SERVER_MAX_SESSIONS 4096
+#define SERVER_MAX_EVENTS 256
+
+// One game, from connecting to the engine closing the connection
+struct session
+{
+    struct transport link;
+    Agent agent;
+    char name[128];
+    char view[5][5];
+    char action;
+    char pending;   // action still to send
+    int blocked;    // the socket had no room for it, epoll waits for it to be writable too
+    int planning;   // given to the workers, the view and action are theirs until it comes back
+    int closed;     // engine closed while planning, free it when it comes back
+    int over;       // game over, freed once the events of this epoll_wait, which may still name it, are done
+    int moves;
+    struct session* next;
+};
+
+typedef struct session* Session;
+
+// Workers taking views from jobs and putting the sessions with their action on done, wake tells the epoll thread
+struct pool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Session jobs;
+    Session jobs_tail;
+    Session done;
+    int wake;
+    int quit;
+    int num;
+    pthread_t* threads;
+};
+
+typedef struct pool* Pool;
+
+static void print_usage(const char* name)
+{
+    printf("Usage: %s [-w workers] [-h host] [-d] -p port[-last] | -u path ...\n", name);
+    exit(1);
+}
+
+static void* worker(void* arg)
+{
+    Pool pool = arg;
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&pool->lock);
+    while(1)
+    {
+        while(pool->jobs==NULL && !pool->quit) pthread_cond_wait(&pool->ready, &pool->lock);
+        if(pool->jobs==NULL) break;
+        Session s = pool->jobs;
+        pool->jobs = s->next;
+        if(pool->jobs==NULL) pool->jobs_tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        s->action = agent_act(s->agent, s->view);
+
+        pthread_mutex_lock(&pool->lock);
+        s->next = pool->done;
+        pool->done = s;
+        if(write(pool->wake, &one, sizeof(one))!=sizeof(one)) perror("eventfd");
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void pool_start(Pool pool, int num)
+{
+    int i;
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready, NULL);
+    pool->wake = eventfd(0, EFD_NONBLOCK);
+    if(pool->wake<0)
+    {
+        perror("eventfd");
+        exit(1);
+    }
+    pool->threads = malloc(num*sizeof(pthread_t));
+    for(i=0; i<num; i++)
+    {
+        if(pthread_create(&pool->threads[i], NULL, worker, pool)!=0) break;
+    }
+    pool->num = i;
+    if(pool->num==0)
+    {
+        printf("cannot start workers\n");
+        exit(1);
+    }
+}
+
+static void pool_stop(Pool pool)
+{
+    int i;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+    for(i=0; i<pool->num; i++) pthread_join(pool->threads[i], NULL);
+    free(pool->threads);
+}
+
+// Give the view of s to the workers, at most one job per session so the queue never holds more than the sessions
+static void pool_submit(Pool pool, Session s)
+{
+    s->planning = 1;
+    s->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if(pool->jobs_tail!=NULL) pool->jobs_tail->next = s;
+    else pool->jobs = s;
+    pool->jobs_tail = s;
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Take all the sessions the workers are done with
+static Session pool_collect(Pool pool)
+{
+    uint64_t count;
+    Session done;
+    if(read(pool->wake, &count, sizeof(count))<0 && errno!=EAGAIN) perror("eventfd");
+    pthread_mutex_lock(&pool->lock);
+    done = pool->done;
+    pool->done = NULL;
+    pthread_mutex_unlock(&pool->lock);
+    return done;
+}
+
+static Session session_open(int sd, const char* name, int delta)
+{
+    Session s = calloc(1, sizeof(struct session));
+    if(s==NULL || (s->agent = agent_create())==NULL)
+    {
+        printf("%s: out of memory\n", name);
+        exit(1);
+    }
+    transport_socket(&s->link, sd);
+    if(delta) transport_handshake(&s->link);
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    agent_init(s->agent);
+    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL)|O_NONBLOCK);
+    return s;
+}
+
+static void session_free(Session s)
+{
+    printf("%s: %d moves, %.3f ms planning, %.3f ms waiting for the engine\n", s->name, s->moves,
+           agent_plan_ns(s->agent)/1e6, pipe_stats(&s->link)->wait_ns/1e6);
+    close(s->link.in);
+    agent_free(s->agent);
+    free(s);
+}
+
+// The engine sent something, plan if a whole view has come. Return 0 if the connection is closed
+static int session_read(Pool pool, Session s)
+{
+    int n = pipe_recv(&s->link);
+    if(n==0 || (n<0 && errno!=EAGAIN)) return 0;
+    if(s->planning) return 1;
+
+    if(pipe_view_ready(&s->link))
+    {
+        if(!pipe_read_view(&s->link, s->view)) return 0;
+        pool_submit(pool, s);
+    }
+    return 1;
+}
+
+// Game over for s: stop waiting on it and put it on dead, to be freed after the events of this epoll_wait
+static void session_over(int ep, Session s, Session* dead)
+{
+    if(!s->closed) epoll_ctl(ep, EPOLL_CTL_DEL, s->link.in, NULL);
+    s->over = 1;
+    s->next = *dead;
+    *dead = s;
+}
+
+// Send the pending action of s. If the socket is full wait until it is writable and try again, as the engine sends
+// nothing more until it has the action. Return 0 if the connection is closed
+static int session_write(int ep, Session s)
+{
+    struct epoll_event ev;
+    int sent = pipe_send_action(&s->link, s->pending);
+
+    if(!sent && errno!=EAGAIN && errno!=EWOULDBLOCK) return 0;
+    if(sent)
+    {
+        s->pending = 0;
+        s->moves++;
+    }
+    if(s->blocked!=!sent)
+    {
+        s->blocked = !sent;
+        ev.events = sent ? EPOLLIN : EPOLLIN|EPOLLOUT;
+        ev.data.ptr = s;
+        epoll_ctl(ep, EPOLL_CTL_MOD, s->link.in, &ev);
+    }
+    return 1;
+}
+
+// The workers planned the next action of s, send it. Return 0 if the game is over: an agent with nothing to do
+// sends nothing, and the engine would wait for it forever
+static int session_act(int ep, Session s)
+{
+    s->planning = 0;
+    if(s->action==0) return 0;
+    s->pending = s->action;
+    return session_write(ep, s);
+}
+
+int main(int argc, char *argv[])
+{
+    static Session sessions[SERVER_MAX_SESSIONS];
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    struct epoll_event ev;
+    struct pool pool;
+    struct timespec begin, end;
+    char* host = "localhost";
+    char name[128];
+    int workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int delta = 0;
+    int num = 0, live, moves = 0;
+    int ep, i, k;
+
+    for(k=1; k<argc; k++)
+    {
+        if(strcmp(argv[k], "-w")==0 && k+1<argc) workers = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-h")==0 && k+1<argc) host = argv[++k];
+        else if(strcmp(argv[k], "-d")==0) delta = 1;
+        else if(strcmp(argv[k], "-p")==0 && k+1<argc) k++;
+        else if(strcmp(argv[k], "-u")==0 && k+1<argc) k++;
+        else print_usage(argv[0]);
+    }
+    if(workers<1) workers = 1;
+
+    // Connect to every engine first, then play all the games
+    for(k=1; k<argc; k++)
+    {
+        if(strcmp(argv[k], "-p")==0)
+        {
+            int first, last;
+            k++;
+            if(sscanf(argv[k], "%d-%d", &first, &last)!=2) last = first = atoi(argv[k]);
+            for(; first<=last && num<SERVER_MAX_SESSIONS; first++)
+            {
+                snprintf(name, sizeof(name), "%s:%d", host, first);
+                sessions[num++] = session_open(tcpopen(host, first), name, delta);
+            }
+        }
+        else if(strcmp(argv[k], "-u")==0 && num<SERVER_MAX_SESSIONS)
+        {
+            k++;
+            sessions[num++] = session_open(unixopen(argv[k]), argv[k], delta);
+        }
+        else if(strcmp(argv[k], "-w")==0 || strcmp(argv[k], "-h")==0) k++;
+    }
+    if(num==0) print_usage(argv[0]);
+
+    ep = epoll_create1(0);
+    if(ep<0)
+    {
+        perror("epoll");
+        exit(1);
+    }
+    pool_start(&pool, workers);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(ep, EPOLL_CTL_ADD, pool.wake, &ev);
+    for(i=0; i<num; i++)
+    {
+        ev.events = EPOLLIN;
+        ev.data.ptr = sessions[i];
+        epoll_ctl(ep, EPOLL_CTL_ADD, sessions[i]->link.in, &ev);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    live = num;
+    while(live>0)
+    {
+        int n = epoll_wait(ep, events, SERVER_MAX_EVENTS, -1);
+        if(n<0 && errno==EINTR) continue;
+        if(n<0)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        Session dead = NULL;
+        for(i=0; i<n; i++)
+        {
+            Session s = events[i].data.ptr;
+            if(s!=NULL && s->over) continue;
+            if(s==NULL)
+            {
+                Session next;
+                for(s=pool_collect(&pool); s!=NULL; s=next)
+                {
+                    next = s->next;
+                    if(!s->closed && session_act(ep, s)) continue;
+                    // Game over, the engine closed the connection while planning or the agent is done with it
+                    if(!s->closed) live--;
+                    session_over(ep, s, &dead);
+                }
+            }
+            else if((events[i].events & EPOLLOUT) && s->pending && !session_write(ep, s))
+            {
+                live--;
+                session_over(ep, s, &dead);
+            }
+            else if((events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR)) && !session_read(&pool, s))
+            {
+                // Game over, the engine closed the connection
+                live--;
+                if(s->planning)
+                {
+                    epoll_ctl(ep, EPOLL_CTL_DEL, s->link.in, NULL);
+                    s->closed = 1;
+                    continue;
+                }
+                session_over(ep, s, &dead);
+            }
+        }
+        while(dead!=NULL)
+        {
+            Session s = dead;
+            dead = s->next;
+            moves += s->moves;
+            session_free(s);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pool_stop(&pool);
+
+    // Sessions closed while planning come back after the last one
+    for(Session s=pool_collect(&pool); s!=NULL; )
+    {
+        Session next = s->next;
+        moves += s->moves;
+        session_free(s);
+        s = next;
+    }
+    close(pool.wake);
+    close(ep);
+
+    double seconds = (end.tv_sec-begin.tv_sec)+(end.tv_nsec-begin.tv_nsec)/1e9;
+    printf("%d games, %d moves in %.3f s, %.1f moves/s\n", num, moves, seconds, moves/seconds);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*********************************************
+ *  sim.c
+ *  Plays the agent on map files with the C engine in the same process, no socket and no JVM.
+ *  Usage: sim [-m maxmoves] [-n games] [-s] [-A] [-a routes] map ...
+ *  With -A the agent's A* searches use the ALT heuristic. With -a (sim_stats only) A* is compared on routes between
+ *  points of the map known at the end of the first game.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "agent.h"
+
+static void print_usage(const char* name)
+{
+    printf("Usage: %s [-m maxmoves] [-n games] [-s] [-A] [-a routes] map ...\n", name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct world world;
+    struct game game = { 0 };
+    Agent agent;
+    struct timespec begin, end;
+    int maxmoves = 10000;
+    int games = 1;
+    int silent = 0;
+    int routes = 0;
+    int alt = 0;
+    long total = 0;
+    int k, g, result, moves;
+    double seconds;
+
+    k = 1;
+    while(k<argc && argv[k][0]=='-')
+    {
+        if(strcmp(argv[k], "-m")==0 && k+1<argc) maxmoves = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-n")==0 && k+1<argc) games = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-s")==0) silent = 1;
+        else if(strcmp(argv[k], "-A")==0) alt = 1;
+        else if(strcmp(argv[k], "-a")==0 && k+1<argc) routes = atoi(argv[++k]);
+        else print_usage(argv[0]);
+        k++;
+    }
+    if(k>=argc || games<1) print_usage(argv[0]);
+
+    agent = agent_create();
+    if(agent==NULL)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    agent_use_alt(agent, alt);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for(; k<argc; k++)
+    {
+        if(!world_load(&world, argv[k]))
+        {
+            printf("%s: can not load map\n", argv[k]);
+            continue;
+        }
+        for(g=0; g<games; g++)
+        {
+            result = game_play(&game, &world, agent, maxmoves, &moves);
+            total++;
+            if(g==0) agent_stats_dump(agent, stderr, argv[k]);
+            if(g==0 && routes>0) agent_astar_compare(agent, routes, stderr, argv[k]);
+            if(silent && g>0) continue;
+            switch(result)
+            {
+                case GAME_WON:   printf("%s: Game Won in %d moves.\n", argv[k], moves); break;
+                case GAME_LOST:  printf("%s: Game Lost in %d moves.\n", argv[k], moves); break;
+                case GAME_STUCK: printf("%s: Agent stuck after %d moves.\n", argv[k], moves); break;
+                default:        printf("%s: Exceeded maximum of %d moves.\n", argv[k], maxmoves); break;
+            }
+        }
+        world_free(&world);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    game_free(&game);
+    agent_free(agent);
+
+    seconds = (end.tv_sec-begin.tv_sec)+(end.tv_nsec-begin.tv_nsec)/1e9;
+    printf("%ld games in %.3f s, %.1f games/s\n", total, seconds, total/seconds);
+    return 0;
+}
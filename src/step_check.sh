@@ -0,0 +1,88 @@
+#!/bin/bash
+# step_check.sh
+# Plays maps against the Java engine (make Step.class first, needs a JDK) in each protocol mode, batch (-b) and delta
+# views (-d) on either side, with agent and agent_server, and checks that every mode gives the same actions as
+# lockstep, one action per view.
+# Usage: ./step_check.sh map ...     ENGINE="java Step" and STEP_TIMEOUT=10 (seconds a game may take) by default
+#
+# Step prints "action = c" for each action it takes, the actions of a game are those lines. A game the agent gives up
+# on never ends in lockstep (the agent waits, so does Step), it is cut at STEP_TIMEOUT and the actions up to there are
+# compared. Exit status 1 if a mode differs from lockstep on some map.
+
+ENGINE=${ENGINE:-java Step}
+STEP_TIMEOUT=${STEP_TIMEOUT:-10}
+PORT=${STEP_PORT:-31415}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# name, engine flags, agent command (the port is added). An agent that asks for delta views (-d) must get them from an
+# engine started with -d and plain views from one started without, an engine with -d must not change an agent that
+# does not ask
+MODES=(
+    "lockstep||./agent"
+    "batch|-b|./agent -b"
+    "engine -d|-d|./agent"
+    "agent -d||./agent -d"
+    "both -d|-d|./agent -d"
+    "batch, agent -d|-b|./agent -b -d"
+    "batch, both -d|-b -d|./agent -b -d"
+    "server -d||./agent_server -d"
+    "server -d, engine -d|-d|./agent_server -d"
+)
+
+# Wait until something listens on port $1, Step accepts only one connection so it can not be tried
+wait_listen()
+{
+    local hex=$(printf '%04X' "$1") k
+    for((k=0; k<STEP_TIMEOUT*10; k++)); do
+        awk -v p=":$hex\$" '$2 ~ p && $4=="0A" { found=1 } END { exit !found }' /proc/net/tcp /proc/net/tcp6 2>/dev/null \
+            && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+# Play map $1 with engine flags $2 and agent command $3, the engine output goes to $4
+play()
+{
+    PORT=$((PORT+1))
+    timeout "$STEP_TIMEOUT" $ENGINE -p "$PORT" -i "$1" $2 >"$4" 2>&1 &
+    local engine=$!
+    if wait_listen "$PORT"; then
+        timeout "$STEP_TIMEOUT" $3 -p "$PORT" >/dev/null 2>&1
+    fi
+    wait "$engine"
+}
+
+# The result line Step printed, stuck if it was cut by the timeout
+result()
+{
+    local line=$(grep -E "Game Won|Game Lost|Exceeded|Lost connection" "$1" | tail -1)
+    echo "${line:-stuck}"
+}
+
+if [ $# -eq 0 ]; then
+    echo "Usage: $0 map ..."
+    exit 2
+fi
+
+bad=0
+for map in "$@"; do
+    name=$(basename "$map")
+    for((m=0; m<${#MODES[@]}; m++)); do
+        IFS='|' read -r mode flags agent <<<"${MODES[$m]}"
+        play "$map" "$flags" "$agent" "$OUT/$name.$m"
+        grep "^action = " "$OUT/$name.$m" >"$OUT/$name.$m.actions"
+        moves=$(wc -l <"$OUT/$name.$m.actions")
+        if [ "$m" -eq 0 ]; then
+            status="$(result "$OUT/$name.$m")"
+        elif cmp -s "$OUT/$name.0.actions" "$OUT/$name.$m.actions"; then
+            status="same actions, $(result "$OUT/$name.$m")"
+        else
+            status="DIFFERENT from lockstep, $(result "$OUT/$name.$m")"
+            bad=1
+        fi
+        printf "%-10s %-24s %5d actions  %s\n" "$name" "$mode" "$moves" "$status"
+    done
+done
+exit $bad
@@ -0,0 +1,278 @@
+/*********************************************
+ *  sweep.c
+ *  Plays every map on all cores with the in-process engine, for a regression sweep in seconds.
+ *  Usage: sweep [-j workers] [-n games] [-m maxmoves] [-o results] map ...
+ *
+ *  Each map is played games times (the engine has no randomness, more games give steadier times). The games are
+ *  dealt to the workers in blocks, each worker takes from the back of its own queue and when it is empty steals half
+ *  of the front of another, so a worker given the slow maps does not hold up the end. Every worker has its own Agent
+ *  and game, only the maps are shared. A line per game is written to the results file as it ends:
+ *      map game result moves plan_us wall_us worker
+ *  and then a line per map and the games per second.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "agent.h"
+
+#define SWEEP_MAX_MAPS 1024
+#define SWEEP_MAX_WORKERS 256
+// Most games taken from another worker at once
+#define SWEEP_STEAL_MAX 64
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+
+// How one game ended
+struct sweepResult
+{
+    int result;
+    int moves;
+    long plan_us;
+    long wall_us;
+};
+
+// Games still to play of one worker, game i is map i/games. The owner takes from tail, thieves from head
+struct sweepQueue
+{
+    pthread_mutex_t lock;
+    int* tasks;
+    int head;
+    int tail;
+};
+
+typedef struct sweepQueue* SweepQueue;
+
+// What every worker shares
+struct sweep
+{
+    struct world worlds[SWEEP_MAX_MAPS];
+    const char* names[SWEEP_MAX_MAPS];
+    int num_maps;
+    int games;
+    int maxmoves;
+    struct sweepResult* results;
+    struct sweepQueue queues[SWEEP_MAX_WORKERS];
+    int num_workers;
+    FILE* out;
+    pthread_mutex_t out_lock;
+};
+
+typedef struct sweep* Sweep;
+
+struct sweepWorker
+{
+    Sweep sweep;
+    int id;
+    long stolen;
+};
+
+typedef struct sweepWorker* SweepWorker;
+
+static const char* result_name[] = { "won", "lost", "stuck", "exceeded" };
+
+static void print_usage(const char* name)
+{
+    printf("Usage: %s [-j workers] [-n games] [-m maxmoves] [-o results] map ...\n", name);
+    exit(1);
+}
+
+// Next game of the worker's own queue, -1 if empty
+static int queue_pop(SweepQueue q)
+{
+    int task = -1;
+    pthread_mutex_lock(&q->lock);
+    if(q->tail>q->head) task = q->tasks[--q->tail];
+    pthread_mutex_unlock(&q->lock);
+    return task;
+}
+
+// Move half the games of victim (at least one, at most SWEEP_STEAL_MAX) to the empty queue of thief, return how
+// many. Only one lock is held at a time, so two workers stealing from each other can not deadlock
+static int queue_steal(SweepQueue thief, SweepQueue victim)
+{
+    int got[SWEEP_STEAL_MAX];
+    int n, i;
+    pthread_mutex_lock(&victim->lock);
+    n = MIN((victim->tail-victim->head+1)/2, SWEEP_STEAL_MAX);
+    for(i=0; i<n; i++) got[i] = victim->tasks[victim->head++];
+    pthread_mutex_unlock(&victim->lock);
+    if(n>0)
+    {
+        pthread_mutex_lock(&thief->lock);
+        if(thief->head==thief->tail) thief->head = thief->tail = 0;
+        for(i=0; i<n; i++) thief->tasks[thief->tail++] = got[i];
+        pthread_mutex_unlock(&thief->lock);
+    }
+    return n;
+}
+
+// Next game for worker w, stealing when its own queue is empty, -1 when no game is left anywhere.
+// Games are only ever dealt at the start, so once every queue is seen empty none comes back
+static int next_task(SweepWorker w)
+{
+    Sweep sweep = w->sweep;
+    SweepQueue own = &sweep->queues[w->id];
+    int task, k;
+
+    while((task = queue_pop(own))<0)
+    {
+        int got = 0;
+        for(k=1; k<sweep->num_workers && !got; k++)
+        {
+            got = queue_steal(own, &sweep->queues[(w->id+k)%sweep->num_workers]);
+        }
+        if(!got) return -1;
+        w->stolen += got;
+    }
+    return task;
+}
+
+static void* worker(void* arg)
+{
+    SweepWorker w = arg;
+    Sweep sweep = w->sweep;
+    struct game game = { 0 };
+    struct timespec begin, end;
+    Agent agent = agent_create();
+    int task;
+
+    if(agent==NULL)
+    {
+        printf("worker %d: out of memory\n", w->id);
+        return NULL;
+    }
+    while((task = next_task(w))>=0)
+    {
+        int map = task/sweep->games;
+        struct sweepResult* r = &sweep->results[task];
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        r->result = game_play(&game, &sweep->worlds[map], agent, sweep->maxmoves, &r->moves);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        r->wall_us = (end.tv_sec-begin.tv_sec)*1000000L+(end.tv_nsec-begin.tv_nsec)/1000;
+        r->plan_us = agent_plan_ns(agent)/1000;
+
+        pthread_mutex_lock(&sweep->out_lock);
+        fprintf(sweep->out, "%s %d %s %d %ld %ld %d\n", sweep->names[map], task%sweep->games,
+                result_name[r->result], r->moves, r->plan_us, r->wall_us, w->id);
+        fflush(sweep->out);
+        pthread_mutex_unlock(&sweep->out_lock);
+    }
+    game_free(&game);
+    agent_free(agent);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct sweep sweep;
+    static struct sweepWorker workers[SWEEP_MAX_WORKERS];
+    pthread_t threads[SWEEP_MAX_WORKERS];
+    struct timespec begin, end;
+    const char* path = "sweep_results.txt";
+    int num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int count[4] = { 0 };
+    int total, started, i, k, m;
+    double seconds;
+
+    sweep.games = 1;
+    sweep.maxmoves = 10000;
+    k = 1;
+    while(k<argc && argv[k][0]=='-')
+    {
+        if(strcmp(argv[k], "-j")==0 && k+1<argc) num_workers = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-n")==0 && k+1<argc) sweep.games = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-m")==0 && k+1<argc) sweep.maxmoves = atoi(argv[++k]);
+        else if(strcmp(argv[k], "-o")==0 && k+1<argc) path = argv[++k];
+        else print_usage(argv[0]);
+        k++;
+    }
+    if(k>=argc || sweep.games<1) print_usage(argv[0]);
+    if(num_workers<1) num_workers = 1;
+    if(num_workers>SWEEP_MAX_WORKERS) num_workers = SWEEP_MAX_WORKERS;
+
+    for(; k<argc && sweep.num_maps<SWEEP_MAX_MAPS; k++)
+    {
+        if(!world_load(&sweep.worlds[sweep.num_maps], argv[k]))
+        {
+            printf("%s: can not load map\n", argv[k]);
+            continue;
+        }
+        sweep.names[sweep.num_maps++] = argv[k];
+    }
+    if(sweep.num_maps==0) return 1;
+
+    sweep.out = fopen(path, "w");
+    if(sweep.out==NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    fprintf(sweep.out, "# map game result moves plan_us wall_us worker\n");
+    pthread_mutex_init(&sweep.out_lock, NULL);
+
+    // Deal the games in blocks, so a worker plays the same map again while it can
+    total = sweep.num_maps*sweep.games;
+    sweep.results = calloc(total, sizeof(struct sweepResult));
+    sweep.num_workers = num_workers;
+    for(i=0; i<num_workers; i++)
+    {
+        SweepQueue q = &sweep.queues[i];
+        pthread_mutex_init(&q->lock, NULL);
+        q->tasks = malloc(total*sizeof(int));
+        q->head = 0;
+        q->tail = 0;
+        for(m=(long)total*i/num_workers; m<(long)total*(i+1)/num_workers; m++) q->tasks[q->tail++] = m;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for(started=0; started<num_workers; started++)
+    {
+        workers[started].sweep = &sweep;
+        workers[started].id = started;
+        if(pthread_create(&threads[started], NULL, worker, &workers[started])!=0) break;
+    }
+    if(started==0)
+    {
+        printf("cannot start workers\n");
+        return 1;
+    }
+    // Games dealt to a worker which did not start are stolen by the others
+    for(i=0; i<started; i++) pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fclose(sweep.out);
+
+    for(m=0; m<sweep.num_maps; m++)
+    {
+        struct sweepResult* r = &sweep.results[m*sweep.games];
+        int won = 0;
+        long plan = 0;
+        for(i=0; i<sweep.games; i++)
+        {
+            if(r[i].result==GAME_WON) won++;
+            count[r[i].result]++;
+            plan += r[i].plan_us;
+        }
+        printf("%s: %s in %d moves, won %d/%d, %.3f ms planning\n", sweep.names[m], result_name[r[0].result],
+               r[0].moves, won, sweep.games, plan/1000.0/sweep.games);
+        world_free(&sweep.worlds[m]);
+    }
+
+    long stolen = 0;
+    for(i=0; i<started; i++) stolen += workers[i].stolen;
+    seconds = (end.tv_sec-begin.tv_sec)+(end.tv_nsec-begin.tv_nsec)/1e9;
+    printf("%d games (%d won, %d lost, %d stuck, %d exceeded) on %d workers, %ld stolen, in %.3f s, %.1f games/s\n",
+           total, count[GAME_WON], count[GAME_LOST], count[GAME_STUCK], count[GAME_EXCEEDED], started, stolen,
+           seconds, total/seconds);
+    printf("results in %s\n", path);
+
+    for(i=0; i<num_workers; i++) free(sweep.queues[i].tasks);
+    free(sweep.results);
+    return 0;
+}